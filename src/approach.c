@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "approach.h"
+#include "kepler.h"
+#include "nbody.h"
+#include "julian.h"
+#include "bench.h"
+#include "catalog.h"
+
+// Newton iterations for the time of minimum distance, at most
+#define APPROACH_ITERATIONS 30
+#define APPROACH_TOLERANCE 1e-6 // days
+// Bodies per Kepler solve when propagating positions and velocities
+#define APPROACH_BLOCK 256
+
+// Scratch and results owned by a single thread
+typedef struct ApproachScratch {
+    coordinates_t *start;  // positions at the start of the step
+    coordinates_t *end;    // and at its end
+    coordinates_t *start_velocity;
+    coordinates_t *end_velocity;
+    size_t next_step;      // step that starts at the positions in end, or SIZE_MAX
+    size_t *cell_start;    // first index into order of every cell, plus one past the end
+    size_t cell_capacity;
+    size_t *order;         // bodies sorted by cell
+    coordinates_t *sorted_start; // start and end positions in the same order, so
+    coordinates_t *sorted_end;   // neighbouring cells are read sequentially
+    size_t *cell;          // cell of every body
+    approach_t *found;
+    size_t count;
+    size_t capacity;
+    size_t checked;
+    size_t refined;
+    int failed;
+} approach_scratch_t;
+
+typedef struct ApproachJob {
+    const elements_t *elements;
+    double start_day;
+    double end_day;
+    double step;
+    size_t steps;
+    double radius;
+    long target;
+    approach_scratch_t *scratch;
+} approach_job_t;
+
+// Uniform grid over the positions at the start of a step, projected on the
+// ecliptic: two bodies within reach in 3D are within reach in x/y too
+typedef struct ApproachGrid {
+    double min_x, min_y;
+    double cell_size;
+    double reach;          // pairs further apart than this can't meet within the step
+    size_t width, height;
+} approach_grid_t;
+
+// Heliocentric position, velocity (AU/day) and acceleration (AU/day^2) of
+// one body. The acceleration uses the GM that matches the body's own mean
+// motion, n^2 a^3, so it is exact for the Keplerian model.
+static void body_state(const elements_t* elements, size_t i, double day, coordinates_t* position,
+                       coordinates_t* velocity, coordinates_t* acceleration) {
+    double e = elements->eccentricity[i];
+    double M = elements->mean_motion[i] * (day - elements->perihelion_day[i]);
+    double E, sinE, cosE;
+    kepler_solve(&M, elements->eccentricity + i, &E, &sinE, &cosE, 1);
+    double rate = elements->mean_motion[i] / (1 - e * cosE); // dE/dt
+    double a = elements->semi_major_axis[i], b = elements->semi_minor_axis[i];
+    double along = a * (cosE - e), across = b * sinE;
+    double along_rate = -a * sinE * rate, across_rate = b * cosE * rate;
+    position->x = along * elements->px[i] + across * elements->qx[i];
+    position->y = along * elements->py[i] + across * elements->qy[i];
+    position->z = along * elements->pz[i] + across * elements->qz[i];
+    velocity->x = along_rate * elements->px[i] + across_rate * elements->qx[i];
+    velocity->y = along_rate * elements->py[i] + across_rate * elements->qy[i];
+    velocity->z = along_rate * elements->pz[i] + across_rate * elements->qz[i];
+
+    double r2 = along * along + across * across;
+    double scale = -elements->mean_motion[i] * elements->mean_motion[i] * a * a * a / (r2 * sqrt(r2));
+    acceleration->x = scale * position->x;
+    acceleration->y = scale * position->y;
+    acceleration->z = scale * position->z;
+}
+
+// Positions and velocities of every body, a block at a time like propagate_all_day
+static void propagate_states(const elements_t* elements, size_t n, double day,
+                             coordinates_t* position, coordinates_t* velocity) {
+    double M[APPROACH_BLOCK], E[APPROACH_BLOCK], sinE[APPROACH_BLOCK], cosE[APPROACH_BLOCK];
+    for (size_t start = 0; start < n; start += APPROACH_BLOCK) {
+        size_t count = n - start < APPROACH_BLOCK ? n - start : APPROACH_BLOCK;
+        for (size_t j = 0; j < count; j++) {
+            M[j] = elements->mean_motion[start + j] * (day - elements->perihelion_day[start + j]);
+        }
+        kepler_solve(M, elements->eccentricity + start, E, sinE, cosE, count);
+
+        for (size_t j = 0; j < count; j++) {
+            size_t i = start + j;
+            double a = elements->semi_major_axis[i], b = elements->semi_minor_axis[i];
+            double e = elements->eccentricity[i];
+            double rate = elements->mean_motion[i] / (1 - e * cosE[j]);
+            double along = a * (cosE[j] - e), across = b * sinE[j];
+            double along_rate = -a * sinE[j] * rate, across_rate = b * cosE[j] * rate;
+            position[i].x = along * elements->px[i] + across * elements->qx[i];
+            position[i].y = along * elements->py[i] + across * elements->qy[i];
+            position[i].z = along * elements->pz[i] + across * elements->qz[i];
+            velocity[i].x = along_rate * elements->px[i] + across_rate * elements->qx[i];
+            velocity[i].y = along_rate * elements->py[i] + across_rate * elements->qy[i];
+            velocity[i].z = along_rate * elements->pz[i] + across_rate * elements->qz[i];
+        }
+    }
+}
+
+// Rate of change of |r_j - r_i|^2 / 2, negative while the bodies close in
+static double closing_rate(const coordinates_t* p, const coordinates_t* v, size_t i, size_t j) {
+    return (p[j].x - p[i].x) * (v[j].x - v[i].x) + (p[j].y - p[i].y) * (v[j].y - v[i].y) +
+           (p[j].z - p[i].z) * (v[j].z - v[i].z);
+}
+
+static double pair_distance(const elements_t* elements, size_t i, size_t j, double day) {
+    coordinates_t pi, vi, ai, pj, vj, aj;
+    body_state(elements, i, day, &pi, &vi, &ai);
+    body_state(elements, j, day, &pj, &vj, &aj);
+    double dx = pj.x - pi.x, dy = pj.y - pi.y, dz = pj.z - pi.z;
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+// Largest distance an orbit strays from the straight line between two
+// positions step days apart, from the Sun's pull at distance r
+static double curvature_slack(double r, double step) {
+    return NBODY_GM_SUN * step * step / (8 * r * r);
+}
+
+static int approach_push(approach_scratch_t* scratch, approach_t approach) {
+    if (scratch->count == scratch->capacity) {
+        size_t capacity = scratch->capacity ? scratch->capacity * 2 : 256;
+        approach_t* grown = realloc(scratch->found, capacity * sizeof(approach_t));
+        if (grown == NULL) {
+            scratch->failed = 1;
+            return -1;
+        }
+        scratch->found = grown;
+        scratch->capacity = capacity;
+    }
+    scratch->found[scratch->count++] = approach;
+    return 0;
+}
+
+// Test bodies i and j, whose positions are p0/p1[a] and p0/p1[b], against
+// the step: the straight-line minimum must come within the radius plus how
+// far the orbits can curve, and the distance must stop shrinking inside the
+// step, so every minimum is solved for by exactly one step. The ends of the
+// search span count as minima when the pair is separating there.
+static void approach_pair(const approach_job_t* job, approach_scratch_t* scratch, size_t step_index,
+                          const coordinates_t* p0, const coordinates_t* p1, size_t a, size_t b,
+                          size_t i, size_t j, double reach) {
+    double dx = p0[b].x - p0[a].x, dy = p0[b].y - p0[a].y, dz = p0[b].z - p0[a].z;
+    scratch->checked++;
+    if (fabs(dx) > reach || fabs(dy) > reach || fabs(dz) > reach) {
+        return;
+    }
+
+    double t0 = job->start_day + step_index * job->step;
+    double t1 = fmin(t0 + job->step, job->end_day);
+    double h = t1 - t0;
+    double ex = p1[b].x - p1[a].x, ey = p1[b].y - p1[a].y, ez = p1[b].z - p1[a].z;
+    double mx = ex - dx, my = ey - dy, mz = ez - dz;
+    double moved = mx * mx + my * my + mz * mz;
+    double s = moved > 0 ? fmax(0, fmin(1, -(dx * mx + dy * my + dz * mz) / moved)) : 0;
+    double r_i = sqrt(fmin(p0[a].x * p0[a].x + p0[a].y * p0[a].y + p0[a].z * p0[a].z,
+                           p1[a].x * p1[a].x + p1[a].y * p1[a].y + p1[a].z * p1[a].z));
+    double r_j = sqrt(fmin(p0[b].x * p0[b].x + p0[b].y * p0[b].y + p0[b].z * p0[b].z,
+                           p1[b].x * p1[b].x + p1[b].y * p1[b].y + p1[b].z * p1[b].z));
+    double cx = dx + s * mx, cy = dy + s * my, cz = dz + s * mz;
+    double limit = job->radius + curvature_slack(r_i, h) + curvature_slack(r_j, h);
+    if (cx * cx + cy * cy + cz * cz >= limit * limit) {
+        return;
+    }
+
+    double f0 = closing_rate(scratch->start, scratch->start_velocity, i, j);
+    double f1 = closing_rate(scratch->end, scratch->end_velocity, i, j);
+    double t = t0 + s * h;
+    if (step_index == 0 && f0 >= 0) {
+        t = t0;
+    } else if (step_index + 1 == job->steps && f1 < 0) {
+        t = t1;
+    } else if (!(f0 < 0 && f1 >= 0)) {
+        return;
+    }
+
+    // Newton on r.v = 0 inside the bracket [t0, t1], bisecting whenever a
+    // Newton step would leave it
+    scratch->refined++;
+    double lo = t0, hi = t1;
+    for (int k = 0; k < APPROACH_ITERATIONS && f0 < 0 && f1 >= 0; k++) {
+        coordinates_t pi, vi, ai, pj, vj, aj;
+        body_state(job->elements, i, t, &pi, &vi, &ai);
+        body_state(job->elements, j, t, &pj, &vj, &aj);
+        double rx = pj.x - pi.x, ry = pj.y - pi.y, rz = pj.z - pi.z;
+        double vx = vj.x - vi.x, vy = vj.y - vi.y, vz = vj.z - vi.z;
+        double f = rx * vx + ry * vy + rz * vz;
+        double slope = vx * vx + vy * vy + vz * vz + rx * (aj.x - ai.x) + ry * (aj.y - ai.y) + rz * (aj.z - ai.z);
+        if (f < 0) {
+            lo = t;
+        } else {
+            hi = t;
+        }
+        double next = slope > 0 ? t - f / slope : lo;
+        if (next <= lo || next >= hi) {
+            next = 0.5 * (lo + hi);
+        }
+        if (fabs(next - t) < APPROACH_TOLERANCE) {
+            t = next;
+            break;
+        }
+        t = next;
+    }
+
+    double distance = pair_distance(job->elements, i, j, t);
+    if (distance < job->radius) {
+        approach_push(scratch, (approach_t){t, i < j ? i : j, i < j ? j : i, distance});
+    }
+}
+
+// Counting sort of the bodies into grid cells
+static int approach_bin(approach_scratch_t* scratch, const approach_grid_t* grid, size_t n) {
+    size_t cells = grid->width * grid->height;
+    if (cells + 1 > scratch->cell_capacity) {
+        size_t* grown = realloc(scratch->cell_start, (cells + 1) * sizeof(size_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        scratch->cell_start = grown;
+        scratch->cell_capacity = cells + 1;
+    }
+    memset(scratch->cell_start, 0, (cells + 1) * sizeof(size_t));
+
+    for (size_t i = 0; i < n; i++) {
+        size_t cx = (size_t)((scratch->start[i].x - grid->min_x) / grid->cell_size);
+        size_t cy = (size_t)((scratch->start[i].y - grid->min_y) / grid->cell_size);
+        scratch->cell[i] = cy * grid->width + cx;
+        scratch->cell_start[scratch->cell[i] + 1]++;
+    }
+    for (size_t c = 0; c < cells; c++) {
+        scratch->cell_start[c + 1] += scratch->cell_start[c];
+    }
+    // cell_start[c] is used as the insertion point and ends up at the next
+    // cell's start, so it is shifted back afterwards
+    for (size_t i = 0; i < n; i++) {
+        size_t k = scratch->cell_start[scratch->cell[i]]++;
+        scratch->order[k] = i;
+        scratch->sorted_start[k] = scratch->start[i];
+        scratch->sorted_end[k] = scratch->end[i];
+    }
+    memmove(scratch->cell_start + 1, scratch->cell_start, cells * sizeof(size_t));
+    scratch->cell_start[0] = 0;
+    return 0;
+}
+
+// Every pair in neighbouring cells, each once: all of the body's own cell
+// after it, and four of the eight neighbours
+static void approach_grid_pairs(const approach_job_t* job, approach_scratch_t* scratch,
+                                const approach_grid_t* grid, size_t step_index) {
+    static const int neighbours[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+    const coordinates_t* p0 = scratch->sorted_start;
+    const coordinates_t* p1 = scratch->sorted_end;
+    const size_t* order = scratch->order;
+    for (size_t cy = 0; cy < grid->height; cy++) {
+        for (size_t cx = 0; cx < grid->width; cx++) {
+            size_t c = cy * grid->width + cx;
+            for (size_t a = scratch->cell_start[c]; a < scratch->cell_start[c + 1]; a++) {
+                for (size_t b = a + 1; b < scratch->cell_start[c + 1]; b++) {
+                    approach_pair(job, scratch, step_index, p0, p1, a, b, order[a], order[b], grid->reach);
+                }
+                for (int k = 0; k < 4; k++) {
+                    long nx = (long)cx + neighbours[k][0];
+                    long ny = (long)cy + neighbours[k][1];
+                    if (nx < 0 || nx >= (long)grid->width || ny >= (long)grid->height) {
+                        continue;
+                    }
+                    size_t other = (size_t)ny * grid->width + (size_t)nx;
+                    for (size_t b = scratch->cell_start[other]; b < scratch->cell_start[other + 1]; b++) {
+                        approach_pair(job, scratch, step_index, p0, p1, a, b, order[a], order[b], grid->reach);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Pool task: steps [begin, end)
+static void approach_chunk(void* context, size_t begin, size_t end, int thread) {
+    approach_job_t* job = context;
+    approach_scratch_t* scratch = &job->scratch[thread];
+    const elements_t* elements = job->elements;
+    size_t n = elements->count;
+
+    for (size_t k = begin; k < end && !scratch->failed; k++) {
+        double t0 = job->start_day + k * job->step;
+        double t1 = fmin(t0 + job->step, job->end_day);
+        if (scratch->next_step == k) {
+            coordinates_t* swap = scratch->start;
+            scratch->start = scratch->end;
+            scratch->end = swap;
+            swap = scratch->start_velocity;
+            scratch->start_velocity = scratch->end_velocity;
+            scratch->end_velocity = swap;
+        } else {
+            propagate_states(elements, n, t0, scratch->start, scratch->start_velocity);
+        }
+        propagate_states(elements, n, t1, scratch->end, scratch->end_velocity);
+        scratch->next_step = k + 1;
+
+        // The cell has to cover the radius plus how far any two bodies can
+        // move towards each other during the step
+        double moved = 0, closest = INFINITY; // squared until the loop is done
+        approach_grid_t grid = {INFINITY, INFINITY, 0, 0, 0, 0};
+        double max_x = -INFINITY, max_y = -INFINITY;
+        for (size_t i = 0; i < n; i++) {
+            coordinates_t p = scratch->start[i], q = scratch->end[i];
+            double d2 = (q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y) + (q.z - p.z) * (q.z - p.z);
+            double rp = p.x * p.x + p.y * p.y + p.z * p.z, rq = q.x * q.x + q.y * q.y + q.z * q.z;
+            double r2 = rp < rq ? rp : rq;
+            moved = d2 > moved ? d2 : moved;
+            closest = r2 < closest ? r2 : closest;
+            grid.min_x = p.x < grid.min_x ? p.x : grid.min_x;
+            grid.min_y = p.y < grid.min_y ? p.y : grid.min_y;
+            max_x = p.x > max_x ? p.x : max_x;
+            max_y = p.y > max_y ? p.y : max_y;
+        }
+
+        moved = sqrt(moved);
+        closest = sqrt(closest);
+        grid.reach = job->radius + 2 * moved + 2 * curvature_slack(closest, t1 - t0);
+
+        if (job->target >= 0) {
+            size_t target = (size_t)job->target;
+            for (size_t j = 0; j < n; j++) {
+                if (j != target) {
+                    approach_pair(job, scratch, k, scratch->start, scratch->end, target, j, target, j, grid.reach);
+                }
+            }
+            continue;
+        }
+
+        double area = (max_x - grid.min_x) * (max_y - grid.min_y);
+        grid.cell_size = fmax(grid.reach, sqrt(area / (APPROACH_CELLS_PER_BODY * (double)n)));
+        grid.width = (size_t)((max_x - grid.min_x) / grid.cell_size) + 1;
+        grid.height = (size_t)((max_y - grid.min_y) / grid.cell_size) + 1;
+        if (approach_bin(scratch, &grid, n) != 0) {
+            scratch->failed = 1;
+            return;
+        }
+        approach_grid_pairs(job, scratch, &grid, k);
+    }
+}
+
+static int compare_approaches(const void* a, const void* b) {
+    const approach_t* left = a;
+    const approach_t* right = b;
+    if (left->day != right->day) {
+        return left->day < right->day ? -1 : 1;
+    }
+    if (left->body != right->body) {
+        return left->body < right->body ? -1 : 1;
+    }
+    return (left->other > right->other) - (left->other < right->other);
+}
+
+int approach_search(const elements_t* elements, double start_day, double end_day, double step,
+                    double radius, long target, int threads, approach_t** approaches, size_t* count,
+                    approach_stats_t* stats) {
+    *approaches = NULL;
+    *count = 0;
+    size_t n = elements->count;
+    if (end_day < start_day || step <= 0 || n < 2) {
+        return -1;
+    }
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+    // An empty range has no steps and finds nothing
+    size_t steps = (size_t)ceil((end_day - start_day) / step);
+
+    approach_scratch_t* scratch = calloc(threads, sizeof(approach_scratch_t));
+    if (scratch == NULL) {
+        return -1;
+    }
+    int result = 0;
+    for (int t = 0; t < threads; t++) {
+        scratch[t].start = malloc(n * sizeof(coordinates_t));
+        scratch[t].end = malloc(n * sizeof(coordinates_t));
+        scratch[t].start_velocity = malloc(n * sizeof(coordinates_t));
+        scratch[t].end_velocity = malloc(n * sizeof(coordinates_t));
+        scratch[t].order = malloc(n * sizeof(size_t));
+        scratch[t].cell = malloc(n * sizeof(size_t));
+        scratch[t].sorted_start = malloc(n * sizeof(coordinates_t));
+        scratch[t].sorted_end = malloc(n * sizeof(coordinates_t));
+        scratch[t].next_step = SIZE_MAX;
+        if (!scratch[t].start || !scratch[t].end || !scratch[t].start_velocity || !scratch[t].end_velocity ||
+            !scratch[t].order || !scratch[t].cell || !scratch[t].sorted_start || !scratch[t].sorted_end) {
+            fprintf(stderr, "not enough memory for %zu bodies on %d threads\n", n, threads);
+            result = -1;
+        }
+    }
+
+    approach_job_t job = {elements, start_day, end_day, step, steps, radius, target, scratch};
+    pool_stats_t pool_stats = {0, 0};
+    if (result == 0) {
+        result = pool_run(threads, steps, APPROACH_CHUNK_STEPS, approach_chunk, &job, &pool_stats);
+    }
+
+    size_t total = 0, checked = 0, refined = 0;
+    for (int t = 0; t < threads; t++) {
+        if (scratch[t].failed) {
+            result = -1;
+        }
+        total += scratch[t].count;
+        checked += scratch[t].checked;
+        refined += scratch[t].refined;
+    }
+
+    approach_t* merged = result == 0 ? malloc((total ? total : 1) * sizeof(approach_t)) : NULL;
+    if (merged != NULL) {
+        for (int t = 0; t < threads; t++) {
+            memcpy(merged + *count, scratch[t].found, scratch[t].count * sizeof(approach_t));
+            *count += scratch[t].count;
+        }
+        qsort(merged, *count, sizeof(approach_t), compare_approaches);
+        *approaches = merged;
+    } else {
+        result = -1;
+    }
+    if (stats != NULL) {
+        *stats = (approach_stats_t){steps, checked, refined, pool_stats};
+    }
+
+    for (int t = 0; t < threads; t++) {
+        free(scratch[t].start);
+        free(scratch[t].end);
+        free(scratch[t].start_velocity);
+        free(scratch[t].end_velocity);
+        free(scratch[t].cell_start);
+        free(scratch[t].order);
+        free(scratch[t].cell);
+        free(scratch[t].sorted_start);
+        free(scratch[t].sorted_end);
+        free(scratch[t].found);
+    }
+    free(scratch);
+    return result;
+}
+
+// Planet name, the catalog's name for the body, or else its index after
+// the planets
+static void body_name(planet_t* planets[], const catalog_t* catalog, size_t i, char* name, size_t size) {
+    if (i < NUM_PLANETS) {
+        snprintf(name, size, "%s", planets[i]->name);
+    } else if (catalog->map != NULL && catalog->names[i - NUM_PLANETS][0] != 0) {
+        snprintf(name, size, "%.*s", CATALOG_NAME_SIZE, catalog->names[i - NUM_PLANETS]);
+    } else {
+        snprintf(name, size, "body_%zu", i - NUM_PLANETS);
+    }
+}
+
+// "approach dd/mm/yyyy dd/mm/yyyy radius_au [step_days] [bodies|catalog_file]
+// [threads] [target]": encounters closer than radius_au among the planets
+// plus a synthetic catalog of bodies or the bodies of a catalog file, as
+// CSV, optionally only those with one planet
+int approach_command(int argc, char* argv[]) {
+    date_t start_date, end_date;
+    double radius = argc > 3 ? atof(argv[3]) : 0;
+    double step = argc > 4 ? atof(argv[4]) : APPROACH_DEFAULT_STEP;
+    int threads = argc > 6 ? atoi(argv[6]) : 0;
+    if (argc < 4 || parse_date(argv[1], &start_date) != 0 || parse_date(argv[2], &end_date) != 0 ||
+        radius <= 0 || step <= 0 || date_to_julian(&end_date) < date_to_julian(&start_date)) {
+        fprintf(stderr, "usage: planets approach dd/mm/yyyy dd/mm/yyyy radius_au [step_days] [bodies|catalog_file] [threads] [target]\n");
+        return 1;
+    }
+    size_t bodies = 0;
+    catalog_t catalog;
+    if (catalog_argument(argc > 5 ? argv[5] : "0", &catalog, &bodies) != 0) {
+        return 1;
+    }
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+
+    planet_t planet_data[NUM_PLANETS];
+    planet_t* planets[NUM_PLANETS];
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i] = &planet_data[i];
+    }
+    load_planets(planets);
+
+    long target = -1;
+    if (argc > 7 && strcmp(argv[7], "all") != 0) {
+        for (int i = 0; i < NUM_PLANETS; i++) {
+            if (strcmp(argv[7], planets[i]->name) == 0) {
+                target = i;
+            }
+        }
+        if (target < 0) {
+            fprintf(stderr, "unknown planet '%s'\n", argv[7]);
+            catalog_close(&catalog);
+            return 1;
+        }
+    }
+
+    elements_t elements;
+    if (elements_init(&elements, NUM_PLANETS + bodies) != 0) {
+        catalog_close(&catalog);
+        return 1;
+    }
+    if (elements_from_planets(&elements, planets, NUM_PLANETS) != 0 ||
+        (catalog.map != NULL ? elements_append(&elements, &catalog.elements)
+                             : elements_add_synthetic(&elements, bodies)) != 0) {
+        elements_free(&elements);
+        catalog_close(&catalog);
+        return 1;
+    }
+
+    approach_t* approaches;
+    size_t count;
+    approach_stats_t stats;
+    double start = bench_now();
+    int result = approach_search(&elements, date_to_julian(&start_date), date_to_julian(&end_date), step,
+                                 radius, target, threads, &approaches, &count, &stats);
+    double elapsed = bench_now() - start;
+    if (result != 0) {
+        fprintf(stderr, "close approach search failed\n");
+        elements_free(&elements);
+        catalog_close(&catalog);
+        return 1;
+    }
+
+    printf("julian_date,date,body,other,distance_au\n");
+    for (size_t k = 0; k < count; k++) {
+        const approach_t* approach = &approaches[k];
+        char body[32], other[32];
+        int year, month, day, hour, minute;
+        julian_calendar(approach->day, &year, &month, &day, &hour, &minute);
+        body_name(planets, &catalog, approach->body, body, sizeof(body));
+        body_name(planets, &catalog, approach->other, other, sizeof(other));
+        printf("%.5f,%02d/%02d/%04dT%02d:%02d,%s,%s,%.6f\n", approach->day, day, month, year, hour, minute,
+               body, other, approach->distance);
+    }
+
+    double n = (double)elements.count;
+    fprintf(stderr, "%zu approaches, %zu bodies x %zu steps on %d threads in %.3f s\n",
+            count, elements.count, stats.steps, threads, elapsed);
+    fprintf(stderr, "%zu pairs checked (%.3e pairs/s, brute force would check %.3e), %zu refined, %zu steals\n",
+            stats.checked, elapsed > 0 ? stats.checked / elapsed : 0,
+            (target >= 0 ? n - 1 : n * (n - 1) / 2) * stats.steps, stats.refined, stats.pool.steals);
+    free(approaches);
+    elements_free(&elements);
+    catalog_close(&catalog);
+    return 0;
+}
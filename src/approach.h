@@ -0,0 +1,42 @@
+#ifndef APPROACH_H
+#define APPROACH_H
+
+#include <stddef.h>
+#include "propagate.h"
+#include "pool.h"
+
+// Default time step in days between grid rebuilds
+#define APPROACH_DEFAULT_STEP 1.0
+// Steps per work-stealing chunk, consecutive steps share their end positions
+#define APPROACH_CHUNK_STEPS 4
+// Cells per body at most, the cell size grows when the grid would be sparser
+#define APPROACH_CELLS_PER_BODY 4
+
+// Closest point of one encounter closer than the search radius
+typedef struct Approach {
+    double day;      // Julian Date of the minimum distance
+    size_t body;
+    size_t other;    // body < other
+    double distance; // AU
+} approach_t;
+
+typedef struct ApproachStats {
+    size_t steps;
+    size_t checked;   // pair distances tested against the grid cell
+    size_t refined;   // pairs whose minimum was solved for
+    pool_stats_t pool;
+} approach_stats_t;
+
+// Every encounter closer than radius AU between start_day and end_day, sorted
+// by date. Positions are binned into a uniform grid every step days and only
+// neighbouring cells are compared, then each candidate's minimum between the
+// two steps is solved for. target >= 0 only looks at encounters with that
+// body. *approaches is malloc'd.
+int approach_search(const elements_t* elements, double start_day, double end_day, double step,
+                    double radius, long target, int threads, approach_t** approaches, size_t* count,
+                    approach_stats_t* stats);
+
+// "approach" mode: close approaches among the planets and a synthetic catalog
+int approach_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,28 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <time.h>
+#include "bench.h"
+
+// Monotonic wall clock in seconds
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Sleep for a possibly fractional number of seconds, nothing when <= 0
+void bench_sleep(double seconds) {
+    if (seconds <= 0) {
+        return;
+    }
+    struct timespec delay;
+    delay.tv_sec = (time_t)seconds;
+    delay.tv_nsec = (long)((seconds - (double)delay.tv_sec) * 1e9);
+    nanosleep(&delay, NULL);
+}
+
+// Throughput line shared by every benchmark
+void bench_report(const char* label, double count, const char* unit, double seconds) {
+    double rate = seconds > 0 ? count / seconds : 0;
+    printf("%-28s %12.0f %s in %8.4f s  (%.3e %s/s)\n", label, count, unit, seconds, rate, unit);
+}
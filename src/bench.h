@@ -0,0 +1,15 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+// Monotonic wall clock in seconds, for timing the batch modes
+double bench_now(void);
+
+// Sleep for seconds, returning at once when it is not positive
+void bench_sleep(double seconds);
+
+// Print "<label>: <count> <unit> in <seconds> s (<rate> <unit>/s)"
+void bench_report(const char* label, double count, const char* unit, double seconds);
+
+#endif
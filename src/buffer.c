@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+#include "buffer.h"
+
+void buffer_init(buffer_t* buffer) {
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+void buffer_free(buffer_t* buffer) {
+    free(buffer->data);
+    buffer_init(buffer);
+}
+
+int buffer_reserve(buffer_t* buffer, size_t size) {
+    if (size < buffer->capacity) {
+        return 0;
+    }
+    size_t capacity = buffer->capacity * 2 > BUFFER_MIN_CAPACITY ? buffer->capacity * 2 : BUFFER_MIN_CAPACITY;
+    if (capacity < size + 1) {
+        capacity = size + 1;
+    }
+    char* data = realloc(buffer->data, capacity);
+    if (data == NULL) {
+        return -1;
+    }
+    buffer->reallocs++;
+    buffer->copied += buffer->size;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+int buffer_append(buffer_t* buffer, const void* data, size_t size) {
+    if (buffer_reserve(buffer, buffer->size + size) != 0) {
+        return -1;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    buffer->copied += size;
+    buffer->data[buffer->size] = 0;
+    return 0;
+}
+
+void buffer_clear(buffer_t* buffer) {
+    buffer->size = 0;
+    if (buffer->data != NULL) {
+        buffer->data[0] = 0;
+    }
+}
+
+void buffer_reset(buffer_t* buffer) {
+    buffer_clear(buffer);
+    buffer->reallocs = 0;
+    buffer->copied = 0;
+}
+
+void buffer_pool_init(buffer_pool_t* pool) {
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+}
+
+void buffer_pool_free(buffer_pool_t* pool) {
+    for (size_t i = 0; i < pool->count; i++) {
+        buffer_free(pool->free[i]);
+        free(pool->free[i]);
+    }
+    pool->count = 0;
+    pthread_mutex_destroy(&pool->lock);
+}
+
+buffer_t* buffer_pool_get(buffer_pool_t* pool) {
+    buffer_t* buffer = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->count > 0) {
+        buffer = pool->free[--pool->count];
+    } else {
+        pool->created++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (buffer == NULL) {
+        buffer = malloc(sizeof(buffer_t));
+        if (buffer != NULL) {
+            buffer_init(buffer);
+        }
+    }
+    if (buffer != NULL) {
+        buffer_reset(buffer);
+    }
+    return buffer;
+}
+
+void buffer_pool_put(buffer_pool_t* pool, buffer_t* buffer) {
+    if (buffer == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    int kept = pool->count < BUFFER_POOL_SIZE && buffer->capacity <= BUFFER_POOL_MAX_CAPACITY;
+    if (kept) {
+        pool->free[pool->count++] = buffer;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (!kept) {
+        buffer_free(buffer);
+        free(buffer);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Growable receive buffer, always NUL terminated once it holds anything.
+// Sized once up front when the length is known, otherwise doubled, so a
+// response costs O(log n) reallocations instead of one per chunk.
+#define BUFFER_MIN_CAPACITY 1024
+#define BUFFER_POOL_SIZE 16
+// Buffers that grew past this are freed rather than pooled, so one large
+// response doesn't pin its memory for the life of the process
+#define BUFFER_POOL_MAX_CAPACITY (4u << 20)
+
+typedef struct Buffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+    size_t reallocs; // calls to realloc since the last reset
+    size_t copied;   // bytes appended plus bytes realloc may have moved
+} buffer_t;
+
+void buffer_init(buffer_t* buffer);
+void buffer_free(buffer_t* buffer);
+
+// Make room for size bytes plus the terminator, -1 when out of memory
+int buffer_reserve(buffer_t* buffer, size_t size);
+int buffer_append(buffer_t* buffer, const void* data, size_t size);
+
+// Empty the buffer, keeping the memory and the counters
+void buffer_clear(buffer_t* buffer);
+
+// Empty the buffer and its counters, keeping the memory
+void buffer_reset(buffer_t* buffer);
+
+// Buffers handed back after a request keep their capacity, so once the
+// pool is warm a request of a familiar size allocates nothing
+typedef struct BufferPool {
+    pthread_mutex_t lock;
+    buffer_t *free[BUFFER_POOL_SIZE];
+    size_t count;
+    size_t created; // buffers allocated because the pool was empty
+} buffer_pool_t;
+
+void buffer_pool_init(buffer_pool_t* pool);
+void buffer_pool_free(buffer_pool_t* pool);
+
+// An empty buffer, NULL when out of memory
+buffer_t* buffer_pool_get(buffer_pool_t* pool);
+void buffer_pool_put(buffer_pool_t* pool, buffer_t* buffer);
+
+#endif
@@ -0,0 +1,163 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+// mkdir -p
+static int make_directories(const char* dir) {
+    char path[CACHE_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (char* slash = strchr(path + 1, '/'); ; slash = strchr(slash + 1, '/')) {
+        if (slash != NULL) {
+            *slash = 0;
+        }
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            return -1;
+        }
+        if (slash == NULL) {
+            return 0;
+        }
+        *slash = '/';
+    }
+}
+
+int cache_open(cache_t* cache, const char* dir, long ttl) {
+    if (strlen(dir) >= sizeof(cache->dir) || make_directories(dir) != 0) {
+        fprintf(stderr, "cannot use cache directory %s\n", dir);
+        return -1;
+    }
+    snprintf(cache->dir, sizeof(cache->dir), "%s", dir);
+    cache->ttl = ttl;
+    return 0;
+}
+
+int cache_open_default(cache_t* cache) {
+    const char* mode = getenv("PLANETS_CACHE");
+    if (mode != NULL && strcmp(mode, "off") == 0) {
+        return -1;
+    }
+    const char* ttl_text = getenv("PLANETS_CACHE_TTL");
+    long ttl = ttl_text != NULL ? atol(ttl_text) : CACHE_DEFAULT_TTL;
+
+    char dir[CACHE_PATH_SIZE];
+    const char* configured = getenv("PLANETS_CACHE_DIR");
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (configured != NULL && configured[0] != 0) {
+        snprintf(dir, sizeof(dir), "%s", configured);
+    } else if (xdg != NULL && xdg[0] != 0) {
+        snprintf(dir, sizeof(dir), "%s/planets", xdg);
+    } else if (home != NULL && home[0] != 0) {
+        snprintf(dir, sizeof(dir), "%s/.cache/planets", home);
+    } else {
+        return -1;
+    }
+    return cache_open(cache, dir, ttl);
+}
+
+// FNV-1a, enough to spread URLs over file names; the URL is checked on lookup
+static void cache_path(const cache_t* cache, const char* url, char path[CACHE_FILE_SIZE]) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const char* c = url; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    snprintf(path, CACHE_FILE_SIZE, "%s/%016llx.http", cache->dir, (unsigned long long)hash);
+}
+
+// Value of "name value" at the start of line, copied up to the end of the line
+static int header_value(const char* line, const char* name, char* out, size_t size) {
+    size_t length = strlen(name);
+    if (strncmp(line, name, length) != 0 || line[length] != ' ') {
+        return -1;
+    }
+    const char* value = line + length + 1;
+    size_t n = strcspn(value, "\n");
+    if (n >= size) {
+        return -1;
+    }
+    memcpy(out, value, n);
+    out[n] = 0;
+    return 0;
+}
+
+int cache_lookup(const cache_t* cache, const char* url, cache_entry_t* entry) {
+    char path[CACHE_FILE_SIZE];
+    cache_path(cache, url, path);
+    memset(entry, 0, sizeof(*entry));
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    char line[CACHE_PATH_SIZE];
+    char value[CACHE_PATH_SIZE];
+    int valid = fgets(line, sizeof(line), file) != NULL && strncmp(line, CACHE_MAGIC "\n", sizeof(CACHE_MAGIC)) == 0;
+    valid = valid && fgets(line, sizeof(line), file) != NULL && header_value(line, "url", value, sizeof(value)) == 0 &&
+            strcmp(value, url) == 0;
+    valid = valid && fgets(line, sizeof(line), file) != NULL && header_value(line, "stored", value, sizeof(value)) == 0;
+    entry->stored = valid ? (time_t)atoll(value) : 0;
+    valid = valid && fgets(line, sizeof(line), file) != NULL &&
+            header_value(line, "etag", entry->etag, sizeof(entry->etag)) == 0;
+    valid = valid && fgets(line, sizeof(line), file) != NULL &&
+            header_value(line, "last-modified", entry->last_modified, sizeof(entry->last_modified)) == 0;
+    valid = valid && fgets(line, sizeof(line), file) != NULL && header_value(line, "length", value, sizeof(value)) == 0;
+    entry->size = valid ? strtoul(value, NULL, 10) : 0;
+    valid = valid && fgets(line, sizeof(line), file) != NULL && strcmp(line, "\n") == 0;
+
+    if (valid) {
+        entry->body = malloc(entry->size + 1);
+        valid = entry->body != NULL && fread(entry->body, 1, entry->size, file) == entry->size;
+    }
+    fclose(file);
+    if (!valid) {
+        cache_entry_free(entry);
+        return -1;
+    }
+    entry->body[entry->size] = 0;
+    return 0;
+}
+
+int cache_fresh(const cache_t* cache, const cache_entry_t* entry) {
+    return difftime(time(NULL), entry->stored) < cache->ttl;
+}
+
+int cache_store(const cache_t* cache, const char* url, const char* body, size_t size,
+                const char* etag, const char* last_modified) {
+    char path[CACHE_FILE_SIZE], temporary[CACHE_FILE_SIZE];
+    cache_path(cache, url, path);
+    snprintf(temporary, sizeof(temporary), "%s/.tmp.XXXXXX", cache->dir);
+    if (strchr(etag, '\n') != NULL || strchr(last_modified, '\n') != NULL) {
+        return -1;
+    }
+
+    int fd = mkstemp(temporary);
+    if (fd < 0) {
+        return -1;
+    }
+    FILE* file = fdopen(fd, "wb");
+    if (file == NULL) {
+        close(fd);
+        unlink(temporary);
+        return -1;
+    }
+    fprintf(file, "%s\nurl %s\nstored %lld\netag %s\nlast-modified %s\nlength %zu\n\n",
+            CACHE_MAGIC, url, (long long)time(NULL), etag, last_modified, size);
+    fwrite(body, 1, size, file);
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed || rename(temporary, path) != 0) {
+        unlink(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+void cache_entry_free(cache_entry_t* entry) {
+    free(entry->body);
+    entry->body = NULL;
+    entry->size = 0;
+}
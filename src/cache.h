@@ -0,0 +1,57 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+
+// On-disk HTTP response cache, one file per URL named after its hash:
+//   PLCACHE 1
+//   url <url>
+//   stored <unix time>
+//   etag <value>             (empty when the server sent none)
+//   last-modified <value>
+//   length <bytes>
+//   <empty line>
+//   <body>
+// Files are written to a temporary name and renamed into place, so
+// concurrent processes only ever see complete entries.
+#define CACHE_MAGIC "PLCACHE 1"
+#define CACHE_DEFAULT_TTL (7 * 24 * 3600) // seconds, planet data hardly changes
+#define CACHE_PATH_SIZE 512
+#define CACHE_FILE_SIZE (CACHE_PATH_SIZE + 32) // directory plus file name
+#define CACHE_VALIDATOR_SIZE 128
+
+typedef struct Cache {
+    char dir[CACHE_PATH_SIZE];
+    long ttl; // seconds an entry is served without asking the server
+} cache_t;
+
+typedef struct CacheEntry {
+    char *body;   // NUL terminated, malloc'd
+    size_t size;
+    time_t stored;
+    char etag[CACHE_VALIDATOR_SIZE];
+    char last_modified[CACHE_VALIDATOR_SIZE];
+} cache_entry_t;
+
+// Cache in dir, created if missing
+int cache_open(cache_t* cache, const char* dir, long ttl);
+
+// Cache from the environment: PLANETS_CACHE_DIR (default
+// $XDG_CACHE_HOME/planets or ~/.cache/planets) and PLANETS_CACHE_TTL in
+// seconds. -1 when PLANETS_CACHE=off or no directory can be used.
+int cache_open_default(cache_t* cache);
+
+// Entry for url, -1 when there is none
+int cache_lookup(const cache_t* cache, const char* url, cache_entry_t* entry);
+
+// 1 while the entry is younger than the TTL
+int cache_fresh(const cache_t* cache, const cache_entry_t* entry);
+
+// Store (or replace) the entry for url, stamped with the current time
+int cache_store(const cache_t* cache, const char* url, const char* body, size_t size,
+                const char* etag, const char* last_modified);
+
+void cache_entry_free(cache_entry_t* entry);
+
+#endif
@@ -0,0 +1,571 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "catalog.h"
+#include "cJSON.h"
+#include "json_arena.h"
+#include "json_stream.h"
+#include "bench.h"
+
+// Bytes read from the file per json_stream_feed
+#define CATALOG_STREAM_CHUNK 65536
+#define CATALOG_JSON_FIELDS 8
+// Bodies the streamed arrays start with, doubled whenever they fill up
+#define CATALOG_STREAM_INITIAL_BODIES 1024
+
+static uint64_t align_up(uint64_t offset) {
+    return (offset + CATALOG_ALIGN - 1) / CATALOG_ALIGN * CATALOG_ALIGN;
+}
+
+// Zeros up to offset
+static void pad_to(FILE* file, uint64_t offset) {
+    static const char zeros[CATALOG_ALIGN];
+    long position = ftell(file);
+    if (position >= 0 && (uint64_t)position < offset) {
+        fwrite(zeros, 1, offset - position, file);
+    }
+}
+
+int catalog_write(const char* path, const elements_t* elements, const char (*names)[CATALOG_NAME_SIZE]) {
+    uint64_t n = elements->count;
+    catalog_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    header.version = CATALOG_VERSION;
+    header.field_count = ELEMENTS_FIELDS;
+    header.count = n;
+    header.names_offset = align_up(sizeof(header));
+    header.fields_offset = align_up(header.names_offset + n * CATALOG_NAME_SIZE);
+    header.field_stride = align_up(n * sizeof(double));
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return -1;
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    pad_to(file, header.names_offset);
+    if (names != NULL) {
+        fwrite(names, CATALOG_NAME_SIZE, n, file);
+    } else {
+        char empty[CATALOG_NAME_SIZE] = {0};
+        for (uint64_t i = 0; i < n; i++) {
+            fwrite(empty, sizeof(empty), 1, file);
+        }
+    }
+
+    double* fields[ELEMENTS_FIELDS];
+    elements_arrays(elements, fields);
+    for (int f = 0; f < ELEMENTS_FIELDS; f++) {
+        pad_to(file, header.fields_offset + f * header.field_stride);
+        fwrite(fields[f], sizeof(double), n, file);
+    }
+    pad_to(file, header.fields_offset + ELEMENTS_FIELDS * header.field_stride);
+
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "error writing %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int catalog_open(catalog_t* catalog, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(catalog_header_t)) {
+        fprintf(stderr, "%s is not a catalog file\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "cannot map %s\n", path);
+        return -1;
+    }
+
+    // Every section has to be aligned and inside the file
+    const catalog_header_t* header = map;
+    uint64_t size = info.st_size;
+    uint64_t n = header->count;
+    int valid = memcmp(header->magic, CATALOG_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == CATALOG_VERSION && header->field_count == ELEMENTS_FIELDS &&
+                header->names_offset % CATALOG_ALIGN == 0 && header->fields_offset % CATALOG_ALIGN == 0 &&
+                header->field_stride % CATALOG_ALIGN == 0 && n <= size / CATALOG_NAME_SIZE &&
+                header->field_stride >= n * sizeof(double) && header->field_stride <= size &&
+                header->names_offset <= size && header->names_offset + n * CATALOG_NAME_SIZE <= size &&
+                header->fields_offset <= size &&
+                (size - header->fields_offset) / ELEMENTS_FIELDS >= header->field_stride;
+    if (!valid) {
+        fprintf(stderr, "%s is not a version %d catalog file\n", path, CATALOG_VERSION);
+        munmap(map, info.st_size);
+        return -1;
+    }
+
+    const char* base = map;
+    double* fields[ELEMENTS_FIELDS];
+    for (int f = 0; f < ELEMENTS_FIELDS; f++) {
+        fields[f] = (double*)(base + header->fields_offset + f * header->field_stride);
+    }
+    elements_t elements = {
+        n, n,
+        fields[0], fields[1], fields[2], fields[3], fields[4],
+        fields[5], fields[6], fields[7],
+        fields[8], fields[9], fields[10],
+        0,
+    };
+
+    catalog->map = map;
+    catalog->size = info.st_size;
+    catalog->header = header;
+    catalog->names = (const char (*)[CATALOG_NAME_SIZE])(base + header->names_offset);
+    catalog->elements = elements;
+    return 0;
+}
+
+void catalog_close(catalog_t* catalog) {
+    if (catalog->map != NULL) {
+        munmap(catalog->map, catalog->size);
+    }
+    catalog->map = NULL;
+    catalog->size = 0;
+}
+
+int catalog_argument(const char* arg, catalog_t* catalog, size_t* bodies) {
+    memset(catalog, 0, sizeof(*catalog));
+    char* end;
+    unsigned long count = strtoul(arg, &end, 10);
+    if (arg[0] != 0 && *end == 0) {
+        *bodies = count;
+        return 0;
+    }
+    if (catalog_open(catalog, arg) != 0) {
+        return -1;
+    }
+    *bodies = catalog->elements.count;
+    return 0;
+}
+
+// Whole file, NUL terminated, malloc'd
+static char* read_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return NULL;
+    }
+    char* text = NULL;
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    if (size >= 0 && fseek(file, 0, SEEK_SET) == 0 && (text = malloc(size + 1)) != NULL) {
+        if (fread(text, 1, size, file) == (size_t)size) {
+            text[size] = 0;
+        } else {
+            free(text);
+            text = NULL;
+        }
+    }
+    fclose(file);
+    if (text == NULL) {
+        fprintf(stderr, "cannot read %s\n", path);
+    }
+    return text;
+}
+
+int catalog_load_json(const char* path, elements_t* elements, char (**names)[CATALOG_NAME_SIZE]) {
+    char* text = read_file(path);
+    if (text == NULL) {
+        return -1;
+    }
+    // The tree is dropped in one go rather than node by node
+    json_arena_t arena;
+    json_arena_init(&arena);
+    cJSON* json = json_arena_parse(&arena, text);
+    free(text);
+    if (!cJSON_IsArray(json)) {
+        fprintf(stderr, "%s is not a JSON array\n", path);
+        json_arena_free(&arena);
+        return -1;
+    }
+
+    size_t n = cJSON_GetArraySize(json);
+    *names = calloc(n > 0 ? n : 1, CATALOG_NAME_SIZE);
+    if (*names == NULL || elements_init(elements, n) != 0) {
+        free(*names);
+        json_arena_free(&arena);
+        return -1;
+    }
+
+    size_t i = 0;
+    const cJSON* body;
+    cJSON_ArrayForEach(body, json) {
+        const cJSON* name = cJSON_GetObjectItemCaseSensitive(body, "name");
+        const cJSON* a = cJSON_GetObjectItemCaseSensitive(body, "semi_major_axis");
+        const cJSON* e = cJSON_GetObjectItemCaseSensitive(body, "eccentricity");
+        const cJSON* period = cJSON_GetObjectItemCaseSensitive(body, "period");
+        const cJSON* perihelion = cJSON_GetObjectItemCaseSensitive(body, "perihelion_day");
+        const cJSON* inclination = cJSON_GetObjectItemCaseSensitive(body, "inclination");
+        const cJSON* node = cJSON_GetObjectItemCaseSensitive(body, "ascending_node");
+        const cJSON* argument = cJSON_GetObjectItemCaseSensitive(body, "argument_of_perihelion");
+        if (!cJSON_IsString(name) || !cJSON_IsNumber(a) || !cJSON_IsNumber(e) || !cJSON_IsNumber(period) ||
+            !cJSON_IsNumber(perihelion) || !cJSON_IsNumber(inclination) || !cJSON_IsNumber(node) ||
+            !cJSON_IsNumber(argument)) {
+            fprintf(stderr, "%s: body %zu is missing a field\n", path, i);
+            break;
+        }
+        strncpy((*names)[i], name->valuestring, CATALOG_NAME_SIZE - 1);
+        elements_add(elements, a->valuedouble, e->valuedouble, period->valuedouble, perihelion->valuedouble,
+                     inclination->valuedouble * DEGREES, node->valuedouble * DEGREES,
+                     argument->valuedouble * DEGREES);
+        i++;
+    }
+    json_arena_free(&arena);
+    if (i < n) {
+        elements_free(elements);
+        free(*names);
+        *names = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Body being assembled from the fields of the current record
+typedef struct CatalogReader {
+    elements_t *elements;
+    char (*names)[CATALOG_NAME_SIZE];
+    char name[CATALOG_NAME_SIZE];
+    double values[CATALOG_JSON_FIELDS];
+    unsigned fields;  // one bit per field seen in this record
+    int failed;
+    double start;
+    double first_record;
+} catalog_reader_t;
+
+static void catalog_field(void* user, const char* key, const char* value, int is_string) {
+    static const char* keys[CATALOG_JSON_FIELDS] = {"name", "semi_major_axis", "eccentricity", "period",
+                                                    "perihelion_day", "inclination", "ascending_node",
+                                                    "argument_of_perihelion"};
+    catalog_reader_t* reader = user;
+    int field = 0;
+    while (field < CATALOG_JSON_FIELDS && strcmp(key, keys[field]) != 0) {
+        field++;
+    }
+    int number = !is_string && (value[0] == '-' || (value[0] >= '0' && value[0] <= '9'));
+    if (field == CATALOG_JSON_FIELDS || (field == 0 ? !is_string : !number)) {
+        return;
+    }
+    if (field == 0) {
+        strncpy(reader->name, value, CATALOG_NAME_SIZE - 1);
+    } else {
+        reader->values[field] = strtod(value, NULL);
+    }
+    reader->fields |= 1u << field;
+}
+
+static void catalog_record(void* user) {
+    catalog_reader_t* reader = user;
+    elements_t* elements = reader->elements;
+    if (reader->failed) {
+        return;
+    }
+    if (reader->fields != (1u << CATALOG_JSON_FIELDS) - 1) {
+        fprintf(stderr, "body %zu is missing a field\n", elements->count);
+        reader->failed = 1;
+        return;
+    }
+    if (elements->count == elements->capacity) {
+        size_t capacity = elements->capacity * 2;
+        char (*names)[CATALOG_NAME_SIZE] = realloc(reader->names, capacity * CATALOG_NAME_SIZE);
+        if (names != NULL) {
+            reader->names = names;
+        }
+        if (names == NULL || elements_reserve(elements, capacity) != 0) {
+            reader->failed = 1;
+            return;
+        }
+    }
+
+    const double* v = reader->values;
+    memcpy(reader->names[elements->count], reader->name, CATALOG_NAME_SIZE);
+    elements_add(elements, v[1], v[2], v[3], v[4], v[5] * DEGREES, v[6] * DEGREES, v[7] * DEGREES);
+    if (elements->count == 1) {
+        reader->first_record = bench_now() - reader->start;
+    }
+    memset(reader->name, 0, sizeof(reader->name));
+    reader->fields = 0;
+}
+
+int catalog_stream_json(const char* path, elements_t* elements, char (**names)[CATALOG_NAME_SIZE],
+                        double* first_record) {
+    catalog_reader_t reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.start = bench_now();
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    reader.elements = elements;
+    reader.names = calloc(CATALOG_STREAM_INITIAL_BODIES, CATALOG_NAME_SIZE);
+    if (reader.names == NULL || elements_init(elements, CATALOG_STREAM_INITIAL_BODIES) != 0) {
+        free(reader.names);
+        fclose(file);
+        return -1;
+    }
+
+    json_stream_handler_t handler = {catalog_field, catalog_record, &reader};
+    json_stream_t stream;
+    buffer_t scratch;
+    buffer_init(&scratch);
+    json_stream_init(&stream, &handler, &scratch);
+    char chunk[CATALOG_STREAM_CHUNK];
+    size_t n;
+    int result = 0;
+    while (result == 0 && !reader.failed && (n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        result = json_stream_feed(&stream, chunk, n);
+    }
+    if (result == 0 && !reader.failed && (ferror(file) || json_stream_finish(&stream) != 0)) {
+        result = -1;
+    }
+    if (result != 0) {
+        fprintf(stderr, "%s: malformed JSON near byte %zu\n", path, stream.offset);
+    }
+    if (result == 0 && stream.containers[0] != '[') {
+        fprintf(stderr, "%s is not a JSON array\n", path);
+        result = -1;
+    }
+    buffer_free(&scratch);
+    fclose(file);
+
+    if (result != 0 || reader.failed) {
+        free(reader.names);
+        elements_free(elements);
+        return -1;
+    }
+    *names = reader.names;
+    if (first_record != NULL) {
+        *first_record = reader.first_record;
+    }
+    return 0;
+}
+
+// "catalog-build catalog_file [json_file]": snapshot a JSON catalog, or the
+// eight planets (from the API with PLANETS_SOURCE=api) when none is given
+int catalog_build_command(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: planets catalog-build catalog_file [json_file]\n");
+        return 1;
+    }
+
+    elements_t elements;
+    char (*names)[CATALOG_NAME_SIZE] = NULL;
+    double start = bench_now();
+    if (argc > 2) {
+        if (catalog_stream_json(argv[2], &elements, &names, NULL) != 0) {
+            return 1;
+        }
+    } else {
+        planet_t planet_data[NUM_PLANETS];
+        planet_t* planets[NUM_PLANETS];
+        for (int i = 0; i < NUM_PLANETS; i++) {
+            planets[i] = &planet_data[i];
+        }
+        load_planets(planets);
+        names = calloc(NUM_PLANETS, CATALOG_NAME_SIZE);
+        if (names == NULL || elements_init(&elements, NUM_PLANETS) != 0) {
+            free(names);
+            return 1;
+        }
+        if (elements_from_planets(&elements, planets, NUM_PLANETS) != 0) {
+            free(names);
+            elements_free(&elements);
+            return 1;
+        }
+        for (int i = 0; i < NUM_PLANETS; i++) {
+            memcpy(names[i], planets[i]->name, sizeof(planets[i]->name));
+        }
+    }
+
+    int result = catalog_write(argv[1], &elements, (const char (*)[CATALOG_NAME_SIZE])names);
+    if (result == 0) {
+        printf("wrote %zu bodies to %s in %.3f s\n", elements.count, argv[1], bench_now() - start);
+    }
+    free(names);
+    elements_free(&elements);
+    return result == 0 ? 0 : 1;
+}
+
+// Reproducible random JSON catalog, same distribution as elements_add_synthetic
+static int write_synthetic_json(const char* path, size_t n) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return -1;
+    }
+    srand(1306);
+    fputs("[\n", file);
+    for (size_t i = 0; i < n; i++) {
+        double a = 0.4 + 40.0 * rand() / RAND_MAX;
+        double e = 0.3 * rand() / RAND_MAX;
+        double period = 365.25 * a * sqrt(a);
+        double perihelion = 2460000.0 + period * rand() / RAND_MAX;
+        double inclination = 20.0 * rand() / RAND_MAX;
+        double node = 360.0 * rand() / RAND_MAX;
+        double argument = 360.0 * rand() / RAND_MAX;
+        fprintf(file, "{\"name\":\"body %zu\",\"semi_major_axis\":%.17g,\"eccentricity\":%.17g,"
+                "\"period\":%.17g,\"perihelion_day\":%.17g,\"inclination\":%.17g,"
+                "\"ascending_node\":%.17g,\"argument_of_perihelion\":%.17g}%s\n",
+                i, a, e, period, perihelion, inclination, node, argument, i + 1 < n ? "," : "");
+    }
+    fputs("]\n", file);
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "error writing %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static double file_megabytes(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 ? info.st_size / 1048576.0 : 0;
+}
+
+// High-water mark of the resident set so far
+static double peak_megabytes(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1048576.0; // bytes
+#else
+    return usage.ru_maxrss / 1024.0;    // kilobytes
+#endif
+}
+
+#define CATALOG_BENCH_DAY 2460000.0
+
+// "catalog-bench [bodies] [prefix]": time from nothing to the first
+// propagated date and peak memory, streaming and parsing <prefix>.json
+// against mapping <prefix>.cat
+int catalog_bench_command(int argc, char* argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    const char* prefix = argc > 2 ? argv[2] : "catalog-bench";
+    char json_path[512], catalog_path[512];
+    if (n == 0 || strlen(prefix) + 6 > sizeof(json_path)) {
+        fprintf(stderr, "usage: planets catalog-bench [bodies] [prefix]\n");
+        return 1;
+    }
+    snprintf(json_path, sizeof(json_path), "%s.json", prefix);
+    snprintf(catalog_path, sizeof(catalog_path), "%s.cat", prefix);
+
+    coordinates_t* from_json = malloc(n * sizeof(coordinates_t));
+    coordinates_t* from_catalog = malloc(n * sizeof(coordinates_t));
+    if (from_json == NULL || from_catalog == NULL) {
+        fprintf(stderr, "not enough memory for %zu positions\n", n);
+        free(from_json);
+        free(from_catalog);
+        return 1;
+    }
+    if (write_synthetic_json(json_path, n) != 0) {
+        free(from_json);
+        free(from_catalog);
+        return 1;
+    }
+
+    // Streamed JSON first, while the peak RSS is still its own
+    elements_t streamed, elements;
+    char (*names)[CATALOG_NAME_SIZE];
+    double first_record = 0;
+    double stream_start = bench_now();
+    if (catalog_stream_json(json_path, &streamed, &names, &first_record) != 0) {
+        free(from_json);
+        free(from_catalog);
+        return 1;
+    }
+    double streamed_at = bench_now();
+    double stream_peak = peak_megabytes();
+    free(names);
+
+    // JSON tree: read, parse, fill the arrays, then propagate
+    double json_start = bench_now();
+    if (catalog_load_json(json_path, &elements, &names) != 0) {
+        elements_free(&streamed);
+        free(from_json);
+        free(from_catalog);
+        return 1;
+    }
+    double loaded = bench_now();
+    double json_peak = peak_megabytes();
+    propagate_all_day(&elements, n, CATALOG_BENCH_DAY, from_json);
+    double json_first = bench_now();
+
+    int same = streamed.count == elements.count;
+    double* a[ELEMENTS_FIELDS];
+    double* b[ELEMENTS_FIELDS];
+    elements_arrays(&streamed, a);
+    elements_arrays(&elements, b);
+    for (int f = 0; f < ELEMENTS_FIELDS && same; f++) {
+        same = memcmp(a[f], b[f], n * sizeof(double)) == 0;
+    }
+    elements_free(&streamed);
+
+    int result = catalog_write(catalog_path, &elements, (const char (*)[CATALOG_NAME_SIZE])names);
+    free(names);
+    elements_free(&elements);
+
+    // Catalog: map, then propagate straight out of the page cache
+    catalog_t catalog;
+    double catalog_start = 0, mapped = 0, catalog_first = 0;
+    if (result == 0) {
+        catalog_start = bench_now();
+        result = catalog_open(&catalog, catalog_path);
+        mapped = bench_now();
+    }
+    if (result == 0) {
+        propagate_all_day(&catalog.elements, n, CATALOG_BENCH_DAY, from_catalog);
+        catalog_first = bench_now();
+        catalog_close(&catalog);
+    }
+    if (result != 0) {
+        free(from_json);
+        free(from_catalog);
+        return 1;
+    }
+
+    double worst = 0;
+    for (size_t i = 0; i < n; i++) {
+        double dx = from_json[i].x - from_catalog[i].x;
+        double dy = from_json[i].y - from_catalog[i].y;
+        double dz = from_json[i].z - from_catalog[i].z;
+        double error = sqrt(dx * dx + dy * dy + dz * dz);
+        worst = error > worst ? error : worst;
+    }
+
+    printf("%zu bodies: %s %.1f MB, %s %.1f MB\n\n", n, json_path, file_megabytes(json_path),
+           catalog_path, file_megabytes(catalog_path));
+    printf("stream:  load %10.3f ms, first record %8.3f ms, peak RSS %7.1f MB\n",
+           (streamed_at - stream_start) * 1e3, first_record * 1e3, stream_peak);
+    printf("json:    load %10.3f ms, first date %8.3f ms, peak RSS %7.1f MB\n", (loaded - json_start) * 1e3,
+           (json_first - loaded) * 1e3, json_peak);
+    printf("catalog: load %10.3f ms, first date %8.3f ms\n", (mapped - catalog_start) * 1e3,
+           (catalog_first - mapped) * 1e3);
+    printf("\nstreamed and parsed elements %s, max position difference %.3e AU\n",
+           same ? "identical" : "DIFFER", worst);
+
+    free(from_json);
+    free(from_catalog);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "propagate.h"
+
+// Binary catalog snapshot: the arrays of an elements_t laid out so the file
+// can be mapped read-only and propagated in place, with no parsing and no
+// copies. Native byte order:
+//   catalog_header_t                        (64 bytes)
+//   char names[count][CATALOG_NAME_SIZE]
+//   double fields[ELEMENTS_FIELDS][count]   in elements_t order
+// The names and every field array start on a CATALOG_ALIGN boundary of the
+// file, and so of the page-aligned mapping, for aligned vector loads.
+#define CATALOG_MAGIC "PLCATLG"
+#define CATALOG_VERSION 1
+#define CATALOG_ALIGN 64 // a cache line, and the widest (AVX-512) vector
+#define CATALOG_NAME_SIZE 16
+
+typedef struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t field_count; // ELEMENTS_FIELDS when written
+    uint64_t count;
+    uint64_t names_offset;
+    uint64_t fields_offset;
+    uint64_t field_stride; // bytes from one field array to the next
+    uint64_t reserved[2];
+} catalog_header_t;
+
+typedef struct Catalog {
+    void *map;
+    size_t size;
+    const catalog_header_t *header;
+    const char (*names)[CATALOG_NAME_SIZE];
+    elements_t elements; // arrays point into the read-only map, never write them
+} catalog_t;
+
+// Write elements and their names (NULL for none) as a catalog file
+int catalog_write(const char* path, const elements_t* elements, const char (*names)[CATALOG_NAME_SIZE]);
+
+// Map a catalog file, catalog->elements is ready to propagate
+int catalog_open(catalog_t* catalog, const char* path);
+void catalog_close(catalog_t* catalog);
+
+// A [bodies] command-line argument: a count of synthetic bodies, or else
+// the path of a catalog file, which is mapped into catalog (map stays NULL
+// for a count). *bodies gets the count either way; -1 when it is neither.
+int catalog_argument(const char* arg, catalog_t* catalog, size_t* bodies);
+
+// The JSON path: parse an array of
+//   {"name", "semi_major_axis" (AU), "eccentricity", "period" (days),
+//    "perihelion_day" (Julian Date), "inclination", "ascending_node",
+//    "argument_of_perihelion" (degrees)}
+// into elements and a malloc'd names array, which the caller frees
+int catalog_load_json(const char* path, elements_t* elements, char (**names)[CATALOG_NAME_SIZE]);
+
+// Same result, but the file is fed to the push parser 64 KB at a time, so
+// memory holds the arrays being filled rather than the document and its
+// tree. first_record, when not NULL, gets the seconds until the first body
+// was ready.
+int catalog_stream_json(const char* path, elements_t* elements, char (**names)[CATALOG_NAME_SIZE],
+                        double* first_record);
+
+// "catalog-build catalog_file [json_file]" and "catalog-bench [bodies] [prefix]" modes
+int catalog_build_command(int argc, char* argv[]);
+int catalog_bench_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "planets.h"
+#include "propagate.h"
+
+// Binary ephemeris cache: piecewise Chebyshev fits of the Keplerian x/y/z of
+// each body. Native byte order, every field 8-byte aligned:
+//   ephemeris_header_t
+//   ephemeris_body_t[body_count]
+//   double coefficients[], per body: [segment][x, y then z][degree + 1]
+#define EPHEMERIS_MAGIC "PLEPHEM"
+#define EPHEMERIS_VERSION 3 // 2: days are Julian Dates, 3: x/y/z
+#define EPHEMERIS_DEFAULT_DEGREE 10
+#define EPHEMERIS_DEFAULT_SEGMENTS_PER_ORBIT 8
+
+typedef struct EphemerisHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t body_count;
+    uint32_t degree;
+    uint32_t reserved;
+    double start_day;
+    double end_day;
+} ephemeris_header_t;
+
+typedef struct EphemerisBody {
+    char name[16];
+    // elements the fit was made from, kept for accuracy checks
+    double semi_major_axis;
+    double eccentricity;
+    double period;
+    double perihelion_day;
+    double p[3], q[3]; // orientation, see elements_t
+    double segment_days;
+    uint64_t segment_count;
+    uint64_t offset; // first coefficient of this body, in doubles
+} ephemeris_body_t;
+
+typedef struct Ephemeris {
+    void *map;
+    size_t size;
+    const ephemeris_header_t *header;
+    const ephemeris_body_t *bodies;
+    const double *coefficients;
+} ephemeris_t;
+
+// Fit every body in elements over [start_day, end_day] and write the file
+int ephemeris_build(const char* path, const elements_t* elements, char names[][15],
+                    double start_day, double end_day, unsigned degree, unsigned segments_per_orbit);
+
+// Map a file built by ephemeris_build read-only
+int ephemeris_open(ephemeris_t* ephemeris, const char* path);
+void ephemeris_close(ephemeris_t* ephemeris);
+
+// x/y/z of one body at a Julian Date, -1 outside the fitted span
+int ephemeris_position(const ephemeris_t* ephemeris, uint32_t body, double day, coordinates_t* out);
+
+// "ephem-build" and "ephem-bench" modes
+int ephemeris_build_command(int argc, char* argv[]);
+int ephemeris_bench_command(int argc, char* argv[]);
+
+#endif
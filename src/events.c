@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "events.h"
+#include "kepler.h"
+#include "julian.h"
+#include "bench.h"
+
+// Refinement stops once the bracket is this short (about 10 ms) or after
+// EVENTS_MAX_ITERATIONS steps
+#define EVENTS_TOLERANCE 1e-7
+#define EVENTS_MAX_ITERATIONS 60
+// Half width of the central difference used to find elongation maxima
+#define EVENTS_DERIVATIVE_STEP 1e-3
+
+// Events found by one thread, appended to without locking
+typedef struct EventsBuffer {
+    event_t *events;
+    size_t count;
+    size_t capacity;
+    int failed;
+} events_buffer_t;
+
+typedef struct EventsJob {
+    const elements_t *elements;
+    double start_day;
+    double step;
+    size_t samples;
+    events_buffer_t *buffers;
+} events_job_t;
+
+// The function whose roots are refined: the sign of the heliocentric
+// longitude difference, or the slope of the elongation
+typedef struct EventsPair {
+    const elements_t *elements;
+    int inner;
+    int outer;
+    int elongation;
+} events_pair_t;
+
+// Heliocentric x/y/z of one body, for the refinement which only needs two
+static coordinates_t body_position(const elements_t* elements, int i, double day) {
+    double M = elements->mean_motion[i] * (day - elements->perihelion_day[i]);
+    double E, sinE, cosE;
+    kepler_solve(&M, elements->eccentricity + i, &E, &sinE, &cosE, 1);
+    double along = elements->semi_major_axis[i] * (cosE - elements->eccentricity[i]);
+    double across = elements->semi_minor_axis[i] * sinE;
+    return (coordinates_t){along * elements->px[i] + across * elements->qx[i],
+                           along * elements->py[i] + across * elements->qy[i],
+                           along * elements->pz[i] + across * elements->qz[i]};
+}
+
+// |r_inner| |r_outer| sin(longitude difference) projected on the ecliptic,
+// zero at conjunction and opposition in heliocentric longitude
+static double longitude_cross(coordinates_t inner, coordinates_t outer) {
+    return inner.x * outer.y - inner.y * outer.x;
+}
+
+// Cosine of the angle between the Sun and inner as seen from outer
+static double elongation_cos(coordinates_t inner, coordinates_t outer) {
+    double ux = -outer.x, uy = -outer.y, uz = -outer.z;
+    double vx = inner.x - outer.x, vy = inner.y - outer.y, vz = inner.z - outer.z;
+    return (ux * vx + uy * vy + uz * vz) / sqrt((ux * ux + uy * uy + uz * uz) * (vx * vx + vy * vy + vz * vz));
+}
+
+static double pair_function(const events_pair_t* pair, double day) {
+    const elements_t* elements = pair->elements;
+    if (!pair->elongation) {
+        return longitude_cross(body_position(elements, pair->inner, day),
+                               body_position(elements, pair->outer, day));
+    }
+    double h = EVENTS_DERIVATIVE_STEP;
+    return elongation_cos(body_position(elements, pair->inner, day + h),
+                          body_position(elements, pair->outer, day + h)) -
+           elongation_cos(body_position(elements, pair->inner, day - h),
+                          body_position(elements, pair->outer, day - h));
+}
+
+// Root of the pair function in [lo, hi] where it changes sign, by false
+// position with the Illinois modification so one end can't get stuck
+static double refine_root(const events_pair_t* pair, double lo, double hi, double f_lo, double f_hi) {
+    int side = 0;
+    for (int k = 0; k < EVENTS_MAX_ITERATIONS && hi - lo > EVENTS_TOLERANCE; k++) {
+        double mid = (lo * f_hi - hi * f_lo) / (f_hi - f_lo);
+        double f_mid = pair_function(pair, mid);
+        if (f_mid == 0) {
+            return mid;
+        }
+        if ((f_mid < 0) == (f_lo < 0)) {
+            lo = mid;
+            f_lo = f_mid;
+            if (side == -1) {
+                f_hi *= 0.5;
+            }
+            side = -1;
+        } else {
+            hi = mid;
+            f_hi = f_mid;
+            if (side == 1) {
+                f_lo *= 0.5;
+            }
+            side = 1;
+        }
+    }
+    return 0.5 * (lo + hi);
+}
+
+static int events_push(events_buffer_t* buffer, event_t event) {
+    if (buffer->count == buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        event_t* grown = realloc(buffer->events, capacity * sizeof(event_t));
+        if (grown == NULL) {
+            buffer->failed = 1;
+            return -1;
+        }
+        buffer->events = grown;
+        buffer->capacity = capacity;
+    }
+    buffer->events[buffer->count++] = event;
+    return 0;
+}
+
+// Refine a bracketed root and record the event it marks
+static void events_add(events_buffer_t* buffer, const events_pair_t* pair, double lo, double hi,
+                       double f_lo, double f_hi) {
+    double day = refine_root(pair, lo, hi, f_lo, f_hi);
+    coordinates_t inner = body_position(pair->elements, pair->inner, day);
+    coordinates_t outer = body_position(pair->elements, pair->outer, day);
+
+    int kind;
+    if (pair->elongation) {
+        // East of the Sun is counterclockwise, the direction the planets move
+        kind = longitude_cross((coordinates_t){-outer.x, -outer.y, -outer.z},
+                               (coordinates_t){inner.x - outer.x, inner.y - outer.y, inner.z - outer.z}) > 0
+                   ? EVENT_ELONGATION_EAST : EVENT_ELONGATION_WEST;
+    } else {
+        // Same side of the Sun: the outer planet is at opposition from the inner one
+        kind = inner.x * outer.x + inner.y * outer.y > 0 ? EVENT_OPPOSITION : EVENT_CONJUNCTION;
+    }
+    double elongation = acos(fmax(-1, fmin(1, elongation_cos(inner, outer)))) * 180 / PI;
+    events_push(buffer, (event_t){day, kind, pair->inner, pair->outer, elongation});
+}
+
+// Pool task: samples [begin, end). Each sample owns the interval to the next
+// one (conjunctions and oppositions) and its own elongation extremum test, so
+// neighbouring chunks never report the same event.
+static void events_chunk(void* context, size_t begin, size_t end, int thread) {
+    events_job_t* job = context;
+    events_buffer_t* buffer = &job->buffers[thread];
+    const elements_t* elements = job->elements;
+    size_t n = elements->count;
+    if (buffer->failed) {
+        return;
+    }
+
+    // Positions at samples k - 1, k and k + 1
+    coordinates_t* window = malloc(3 * n * sizeof(coordinates_t));
+    if (window == NULL) {
+        buffer->failed = 1;
+        return;
+    }
+    coordinates_t* previous = window;
+    coordinates_t* current = window + n;
+    coordinates_t* next = window + 2 * n;
+    size_t first = begin > 0 ? begin - 1 : 0;
+    propagate_all_day(elements, n, job->start_day + first * job->step, previous);
+    propagate_all_day(elements, n, job->start_day + begin * job->step, current);
+
+    for (size_t k = begin; k < end && k + 1 < job->samples && !buffer->failed; k++) {
+        double day = job->start_day + k * job->step;
+        propagate_all_day(elements, n, day + job->step, next);
+
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = i + 1; j < n; j++) {
+                int inner = elements->semi_major_axis[i] <= elements->semi_major_axis[j] ? (int)i : (int)j;
+                int outer = inner == (int)i ? (int)j : (int)i;
+                events_pair_t pair = {elements, inner, outer, 0};
+
+                double c0 = longitude_cross(current[inner], current[outer]);
+                double c1 = longitude_cross(next[inner], next[outer]);
+                if ((c0 < 0) != (c1 < 0)) {
+                    events_add(buffer, &pair, day, day + job->step, c0, c1);
+                }
+
+                // Elongation maximum: the cosine has a minimum at sample k
+                if (k == 0) {
+                    continue;
+                }
+                double e0 = elongation_cos(previous[inner], previous[outer]);
+                double e1 = elongation_cos(current[inner], current[outer]);
+                double e2 = elongation_cos(next[inner], next[outer]);
+                if (e1 < e0 && e1 <= e2) {
+                    pair.elongation = 1;
+                    double lo = day - job->step, hi = day + job->step;
+                    double f_lo = pair_function(&pair, lo), f_hi = pair_function(&pair, hi);
+                    if ((f_lo < 0) != (f_hi < 0)) {
+                        events_add(buffer, &pair, lo, hi, f_lo, f_hi);
+                    }
+                }
+            }
+        }
+
+        coordinates_t* recycled = previous;
+        previous = current;
+        current = next;
+        next = recycled;
+    }
+    free(window);
+}
+
+static int compare_events(const void* a, const void* b) {
+    const event_t* left = a;
+    const event_t* right = b;
+    if (left->day != right->day) {
+        return left->day < right->day ? -1 : 1;
+    }
+    if (left->body != right->body) {
+        return left->body - right->body;
+    }
+    return left->other - right->other;
+}
+
+int events_search(const elements_t* elements, double start_day, double end_day, double step,
+                  int threads, event_t** events, size_t* count, pool_stats_t* stats) {
+    *events = NULL;
+    *count = 0;
+    if (end_day < start_day) {
+        return -1;
+    }
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+    events_buffer_t* buffers = calloc(threads, sizeof(events_buffer_t));
+    if (buffers == NULL) {
+        return -1;
+    }
+    size_t samples = (size_t)((end_day - start_day) / step) + 2;
+    events_job_t job = {elements, start_day, step, samples, buffers};
+
+    int result = pool_run(threads, samples, EVENTS_CHUNK_SAMPLES, events_chunk, &job, stats);
+    size_t total = 0;
+    for (int t = 0; t < threads; t++) {
+        if (buffers[t].failed) {
+            result = -1;
+        }
+        total += buffers[t].count;
+    }
+
+    event_t* merged = result == 0 ? malloc((total ? total : 1) * sizeof(event_t)) : NULL;
+    if (merged != NULL) {
+        // Events past end_day come from the last interval, which overshoots
+        for (int t = 0; t < threads; t++) {
+            for (size_t k = 0; k < buffers[t].count; k++) {
+                if (buffers[t].events[k].day >= start_day && buffers[t].events[k].day <= end_day) {
+                    merged[(*count)++] = buffers[t].events[k];
+                }
+            }
+        }
+        qsort(merged, *count, sizeof(event_t), compare_events);
+        *events = merged;
+    } else {
+        result = -1;
+    }
+
+    for (int t = 0; t < threads; t++) {
+        free(buffers[t].events);
+    }
+    free(buffers);
+    return result;
+}
+
+static const char* event_names[] = {"conjunction", "opposition", "greatest_elongation_east", "greatest_elongation_west"};
+
+// "events dd/mm/yyyy dd/mm/yyyy [step_days] [threads]": every conjunction,
+// opposition and greatest elongation of the planets as CSV, in date order
+int events_command(int argc, char* argv[]) {
+    date_t start_date, end_date;
+    double step = argc > 3 ? atof(argv[3]) : EVENTS_DEFAULT_STEP;
+    int threads = argc > 4 ? atoi(argv[4]) : 0;
+    if (argc < 3 || parse_date(argv[1], &start_date) != 0 || parse_date(argv[2], &end_date) != 0 || step <= 0 ||
+        date_to_julian(&end_date) < date_to_julian(&start_date)) {
+        fprintf(stderr, "usage: planets events dd/mm/yyyy dd/mm/yyyy [step_days] [threads]\n");
+        return 1;
+    }
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+
+    planet_t planet_data[NUM_PLANETS];
+    planet_t* planets[NUM_PLANETS];
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i] = &planet_data[i];
+    }
+    load_planets(planets);
+
+    elements_t elements;
+    double storage[ELEMENTS_FIELDS * NUM_PLANETS];
+    elements_init_with(&elements, storage, NUM_PLANETS);
+    if (elements_from_planets(&elements, planets, NUM_PLANETS) != 0) {
+        return 1;
+    }
+
+    event_t* events;
+    size_t count;
+    pool_stats_t stats;
+    double start = bench_now();
+    if (events_search(&elements, date_to_julian(&start_date), date_to_julian(&end_date), step,
+                      threads, &events, &count, &stats) != 0) {
+        fprintf(stderr, "event search failed\n");
+        return 1;
+    }
+    double elapsed = bench_now() - start;
+
+    size_t kinds[4] = {0};
+    printf("julian_date,date,event,planet,other,elongation_deg\n");
+    for (size_t k = 0; k < count; k++) {
+        const event_t* event = &events[k];
+        int year, month, day, hour, minute;
+        julian_calendar(event->day, &year, &month, &day, &hour, &minute);
+        printf("%.5f,%02d/%02d/%04dT%02d:%02d,%s,%s,%s,%.3f\n", event->day, day, month, year, hour, minute,
+               event_names[event->kind], planets[event->body]->name, planets[event->other]->name,
+               event->elongation);
+        kinds[event->kind]++;
+    }
+
+    fprintf(stderr, "%zu events (%zu conjunctions, %zu oppositions, %zu greatest elongations) "
+            "in %.3f ms on %d threads, %zu chunks, %zu steals\n",
+            count, kinds[EVENT_CONJUNCTION], kinds[EVENT_OPPOSITION],
+            kinds[EVENT_ELONGATION_EAST] + kinds[EVENT_ELONGATION_WEST],
+            elapsed * 1e3, threads, stats.chunks, stats.steals);
+    free(events);
+    return 0;
+}
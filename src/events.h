@@ -0,0 +1,43 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stddef.h>
+#include "propagate.h"
+#include "pool.h"
+
+// Event kinds, named from the inner planet's viewpoint. At an opposition the
+// two planets share a heliocentric longitude, so the outer planet is opposite
+// the Sun as seen from the inner one (and the inner planet is at inferior
+// conjunction as seen from the outer one). At a conjunction their longitudes
+// are 180 degrees apart and the outer planet is behind the Sun as seen from
+// the inner one (superior conjunction either way). Greatest elongations are
+// of the inner planet as seen from the outer one, east or west of the Sun.
+#define EVENT_CONJUNCTION 0
+#define EVENT_OPPOSITION 1
+#define EVENT_ELONGATION_EAST 2
+#define EVENT_ELONGATION_WEST 3
+
+// Default coarse scan step in days, well below the shortest half synodic
+// period (Mercury and Earth, about 58 days)
+#define EVENTS_DEFAULT_STEP 1.0
+// Samples per work-stealing chunk
+#define EVENTS_CHUNK_SAMPLES 1024
+
+typedef struct Event {
+    double day;        // Julian Date
+    int kind;
+    int body;          // inner planet
+    int other;         // outer planet, the observer for elongations
+    double elongation; // degrees, angle between the Sun and body seen from other
+} event_t;
+
+// Every event between start_day and end_day for all pairs of bodies, sorted
+// by date. The span is scanned every step days in parallel, sign changes are
+// bracketed and then refined to well under a second. *events is malloc'd.
+int events_search(const elements_t* elements, double start_day, double end_day, double step,
+                  int threads, event_t** events, size_t* count, pool_stats_t* stats);
+
+// "events" mode: event list for the planets as CSV
+int events_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,1051 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <curl/curl.h>
+#include "fetch.h"
+#include "json_stream.h"
+#include "bench.h"
+
+#define FETCH_KEY_HEADER "X-Api-Key: " FETCH_API_KEY
+// Longest wait for socket activity before curl_multi_poll returns anyway
+#define FETCH_POLL_MS 1000
+
+// Planet fields as the stream parser reports them, from the first record
+typedef struct PlanetReader {
+    planet_t *planet;
+    unsigned fields; // one bit per required field seen
+    size_t records;
+} planet_reader_t;
+
+#define PLANET_FIELDS 7
+
+static void planet_field(void* user, const char* key, const char* value, int is_string) {
+    static const char* names[PLANET_FIELDS] = {"name", "mass", "radius", "period", "semi_major_axis",
+                                               "temperature", "distance_light_year"};
+    planet_reader_t* reader = user;
+    planet_t* planet = reader->planet;
+    int field = 0;
+    while (field < PLANET_FIELDS && strcmp(key, names[field]) != 0) {
+        field++;
+    }
+    // name is the only string, the rest must be numbers
+    int number = !is_string && (value[0] == '-' || (value[0] >= '0' && value[0] <= '9'));
+    if (reader->records > 0 || field == PLANET_FIELDS || (field == 0 ? !is_string : !number)) {
+        return;
+    }
+    double x = field > 0 ? strtod(value, NULL) : 0;
+    switch (field) {
+    case 0: strncpy(planet->name, value, sizeof(planet->name) - 1); break;
+    case 1: planet->mass = x * 100; break;
+    case 2: planet->radius = x * 100; break;
+    case 3: planet->period = x; break;
+    case 4: planet->semi_major_axis = x; break;
+    case 5: planet->temperature = x; break;
+    case 6: planet->distance_light_year = x; break;
+    }
+    reader->fields |= 1u << field;
+}
+
+static void planet_record(void* user) {
+    ((planet_reader_t*)user)->records++;
+}
+
+static void planet_reader_init(planet_reader_t* reader, json_stream_t* stream, buffer_t* scratch, planet_t* planet) {
+    json_stream_handler_t handler = {planet_field, planet_record, reader};
+    memset(planet, 0, sizeof(*planet));
+    reader->planet = planet;
+    reader->fields = 0;
+    reader->records = 0;
+    json_stream_init(stream, &handler, scratch);
+}
+
+// 0 once the whole document parsed and its first record had every field
+static int planet_reader_finish(planet_reader_t* reader, json_stream_t* stream) {
+    return json_stream_finish(stream) == 0 && reader->records > 0 &&
+           reader->fields == (1u << PLANET_FIELDS) - 1 ? 0 : -1;
+}
+
+int planet_from_json(const char* text, planet_t* planet) {
+    planet_reader_t reader;
+    json_stream_t stream;
+    buffer_t scratch;
+    buffer_init(&scratch);
+    planet_reader_init(&reader, &stream, &scratch, planet);
+    json_stream_feed(&stream, text, strlen(text));
+    int parsed = planet_reader_finish(&reader, &stream);
+    buffer_free(&scratch);
+    return parsed;
+}
+
+static pthread_once_t fetch_client_once = PTHREAD_ONCE_INIT;
+static fetch_client_t fetch_shared;
+
+static void fetch_lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* user) {
+    (void)handle;
+    (void)access;
+    pthread_mutex_lock(&((fetch_client_t*)user)->locks[data]);
+}
+
+static void fetch_unlock(CURL* handle, curl_lock_data data, void* user) {
+    (void)handle;
+    pthread_mutex_unlock(&((fetch_client_t*)user)->locks[data]);
+}
+
+static void fetch_client_cleanup(void) {
+    fetch_client_t* client = &fetch_shared;
+    if (client->easy != NULL) {
+        curl_easy_cleanup(client->easy);
+    }
+    if (client->share != NULL) {
+        curl_share_cleanup(client->share);
+    }
+    curl_slist_free_all(client->headers);
+    buffer_pool_free(&client->buffers);
+    curl_global_cleanup();
+}
+
+static long fetch_env_long(const char* name, long fallback) {
+    const char* text = getenv(name);
+    char* end;
+    long value = text != NULL ? strtol(text, &end, 10) : fallback;
+    return text != NULL && (end == text || *end != 0 || value < 0) ? fallback : value;
+}
+
+static void fetch_policy_load(fetch_policy_t* policy) {
+    policy->connect_timeout_ms = fetch_env_long("PLANETS_CONNECT_TIMEOUT_MS", FETCH_CONNECT_TIMEOUT_MS);
+    policy->timeout_ms = fetch_env_long("PLANETS_TIMEOUT_MS", FETCH_TIMEOUT_MS);
+    policy->retries = (int)fetch_env_long("PLANETS_RETRIES", FETCH_RETRIES);
+    const char* hedge = getenv("PLANETS_HEDGE");
+    policy->hedge_ms = hedge == NULL || strcmp(hedge, "off") == 0 ? 0
+                     : strcmp(hedge, "p95") == 0 ? -1 : (double)fetch_env_long("PLANETS_HEDGE", 0);
+}
+
+static void fetch_client_create(void) {
+    fetch_client_t* client = &fetch_shared;
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&client->locks[i], NULL);
+    }
+    client->headers = curl_slist_append(NULL, FETCH_KEY_HEADER);
+    client->share = curl_share_init();
+    if (client->share != NULL) {
+        curl_share_setopt(client->share, CURLSHOPT_LOCKFUNC, fetch_lock);
+        curl_share_setopt(client->share, CURLSHOPT_UNLOCKFUNC, fetch_unlock);
+        curl_share_setopt(client->share, CURLSHOPT_USERDATA, client);
+        curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+    client->easy = curl_easy_init();
+    // Leave room for the longest planet name
+    const char* url = getenv(FETCH_API_URL_ENV);
+    if (url != NULL && strlen(url) + 64 > sizeof(client->api_url)) {
+        fprintf(stderr, "%s is too long, using %s\n", FETCH_API_URL_ENV, FETCH_API_URL);
+        url = NULL;
+    }
+    snprintf(client->api_url, sizeof(client->api_url), "%s", url != NULL && url[0] != 0 ? url : FETCH_API_URL);
+    fetch_policy_load(&client->policy);
+    pthread_mutex_init(&client->latency_lock, NULL);
+    pthread_mutex_init(&client->quota.lock, NULL);
+    pthread_mutex_init(&client->flight_lock, NULL);
+    pthread_cond_init(&client->flight_done, NULL);
+    client->coalesce = 1;
+    double rate = (double)fetch_env_long("PLANETS_RATE_LIMIT", 0);
+    fetch_quota_set(client, rate, (double)fetch_env_long("PLANETS_RATE_BURST", rate > 1 ? (long)rate : 1));
+    buffer_pool_init(&client->buffers);
+    client->cache = cache_open_default(&client->cache_storage) == 0 ? &client->cache_storage : NULL;
+    atexit(fetch_client_cleanup);
+}
+
+void fetch_quota_set(fetch_client_t* client, double rate, double burst) {
+    fetch_quota_t* quota = &client->quota;
+    pthread_mutex_lock(&quota->lock);
+    quota->rate = rate > 0 ? rate : 0;
+    quota->burst = burst >= 1 ? burst : 1;
+    quota->tokens = quota->burst;
+    quota->updated = bench_now();
+    pthread_mutex_unlock(&quota->lock);
+}
+
+static void fetch_quota_refill(fetch_quota_t* quota, double now) {
+    quota->tokens += (now - quota->updated) * quota->rate;
+    quota->tokens = quota->tokens < quota->burst ? quota->tokens : quota->burst;
+    quota->updated = now;
+}
+
+// Take the next token, returns the seconds until it comes due
+static double fetch_quota_reserve(fetch_quota_t* quota) {
+    pthread_mutex_lock(&quota->lock);
+    double wait = 0;
+    if (quota->rate > 0) {
+        fetch_quota_refill(quota, bench_now());
+        quota->tokens -= 1;
+        wait = quota->tokens < 0 ? -quota->tokens / quota->rate : 0;
+    }
+    pthread_mutex_unlock(&quota->lock);
+    return wait;
+}
+
+// Take a token only if one is free now, for requests that aren't worth a wait
+static int fetch_quota_try(fetch_quota_t* quota) {
+    pthread_mutex_lock(&quota->lock);
+    int taken = 1;
+    if (quota->rate > 0) {
+        fetch_quota_refill(quota, bench_now());
+        taken = quota->tokens >= 1;
+        quota->tokens -= taken;
+    }
+    pthread_mutex_unlock(&quota->lock);
+    return taken;
+}
+
+fetch_client_t* fetch_client(void) {
+    pthread_once(&fetch_client_once, fetch_client_create);
+    return &fetch_shared;
+}
+
+// One planet's request: where the response goes and what the cache knew.
+// The body is parsed as it arrives and only kept whole for the cache.
+typedef struct FetchTransfer {
+    planet_reader_t reader;
+    json_stream_t stream;
+    planet_t planet;
+    buffer_t *scratch;           // the stream's value, from the client's pool
+    buffer_t *body;              // the whole body when it is to be cached, else NULL
+    char url[FETCH_URL_SIZE];
+    struct curl_slist *headers;  // the key plus validators when revalidating, else NULL
+    cache_entry_t cached;        // stale entry being revalidated, body NULL when none
+    char etag[CACHE_VALIDATOR_SIZE];
+    char last_modified[CACHE_VALIDATOR_SIZE];
+} fetch_transfer_t;
+
+// Response bytes go to the parser straight away, and to the cache copy
+static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+  size_t realsize = size * nmemb;
+  fetch_transfer_t *transfer = (fetch_transfer_t *)userp;
+
+  // A malformed body is consumed anyway and reported once the transfer is done
+  json_stream_feed(&transfer->stream, contents, realsize);
+  if (transfer->body != NULL && buffer_append(transfer->body, contents, realsize) != 0) {
+    printf("not enough memory (realloc returned NULL)\n");
+    return 0;
+  }
+  return realsize;
+}
+
+// Copy the value of a "Name: value" header line if it is the named one
+static void fetch_validator(const char* line, size_t length, const char* name, char out[CACHE_VALIDATOR_SIZE]) {
+    size_t n = strlen(name);
+    if (length <= n) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (tolower((unsigned char)line[i]) != name[i]) {
+            return;
+        }
+    }
+    const char* value = line + n;
+    size_t rest = length - n;
+    while (rest > 0 && (*value == ' ' || *value == '\t')) {
+        value++;
+        rest--;
+    }
+    while (rest > 0 && (value[rest - 1] == '\r' || value[rest - 1] == '\n' || value[rest - 1] == ' ')) {
+        rest--;
+    }
+    if (rest < CACHE_VALIDATOR_SIZE) {
+        memcpy(out, value, rest);
+        out[rest] = 0;
+    }
+}
+
+static size_t fetch_header(char* buffer, size_t size, size_t nitems, void* userdata) {
+    fetch_transfer_t* transfer = userdata;
+    size_t length = size * nitems;
+    char content_length[CACHE_VALIDATOR_SIZE] = "";
+    fetch_validator(buffer, length, "etag:", transfer->etag);
+    fetch_validator(buffer, length, "last-modified:", transfer->last_modified);
+    fetch_validator(buffer, length, "content-length:", content_length);
+    // Size the body once instead of growing it chunk by chunk, but never
+    // trust the server with more than FETCH_PRESIZE_MAX up front
+    if (content_length[0] != 0 && transfer->body != NULL) {
+        unsigned long size = strtoul(content_length, NULL, 10);
+        buffer_reserve(transfer->body, size < FETCH_PRESIZE_MAX ? size : FETCH_PRESIZE_MAX);
+    }
+    return length;
+}
+
+// Receive buffer for one request: pooled on a client, a one-off otherwise
+static buffer_t* fetch_buffer_get(fetch_client_t* client) {
+    if (client != NULL) {
+        return buffer_pool_get(&client->buffers);
+    }
+    buffer_t* buffer = malloc(sizeof(buffer_t));
+    if (buffer != NULL) {
+        buffer_init(buffer);
+    }
+    return buffer;
+}
+
+static void fetch_buffer_put(fetch_client_t* client, buffer_t* buffer) {
+    if (client != NULL) {
+        buffer_pool_put(&client->buffers, buffer);
+    } else if (buffer != NULL) {
+        buffer_free(buffer);
+        free(buffer);
+    }
+}
+
+// Start a transfer for one planet. Returns 1 when a fresh cache entry
+// already holds the response, so no request is needed, 0 when the
+// transfer is ready for a request and -1 when out of memory or the URL
+// doesn't fit.
+static int fetch_begin(fetch_transfer_t* transfer, fetch_client_t* client, const char* planet_name) {
+    memset(transfer, 0, sizeof(*transfer));
+    // A fresh handle still goes to the configured server
+    int length = snprintf(transfer->url, FETCH_URL_SIZE, "%s%s", fetch_client()->api_url, planet_name);
+    if (length < 0 || length >= FETCH_URL_SIZE) {
+        fprintf(stderr, "URL for %s is too long\n", planet_name);
+        return -1;
+    }
+    cache_t* cache = client != NULL ? client->cache : NULL;
+    if (cache != NULL && cache_lookup(cache, transfer->url, &transfer->cached) == 0 &&
+        cache_fresh(cache, &transfer->cached)) {
+        return 1;
+    }
+    transfer->scratch = fetch_buffer_get(client);
+    transfer->body = cache != NULL ? fetch_buffer_get(client) : NULL;
+    if (transfer->scratch == NULL || (cache != NULL && transfer->body == NULL)) {
+        return -1;
+    }
+    planet_reader_init(&transfer->reader, &transfer->stream, transfer->scratch, &transfer->planet);
+    if (transfer->cached.body == NULL) {
+        return 0;
+    }
+
+    // Stale: only download the body again if it changed
+    char line[CACHE_VALIDATOR_SIZE + 32];
+    transfer->headers = curl_slist_append(NULL, FETCH_KEY_HEADER);
+    if (transfer->cached.etag[0] != 0) {
+        snprintf(line, sizeof(line), "If-None-Match: %s", transfer->cached.etag);
+        transfer->headers = curl_slist_append(transfer->headers, line);
+    }
+    if (transfer->cached.last_modified[0] != 0) {
+        snprintf(line, sizeof(line), "If-Modified-Since: %s", transfer->cached.last_modified);
+        transfer->headers = curl_slist_append(transfer->headers, line);
+    }
+    return 0;
+}
+
+// Point an easy handle at a transfer. With a client the handle joins its
+// share and keeps connections alive.
+static void fetch_setup(CURL* curl, fetch_client_t* client, struct curl_slist* headers, fetch_transfer_t* transfer) {
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->headers != NULL ? transfer->headers : headers);
+    curl_easy_setopt(curl, CURLOPT_URL, transfer->url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)transfer);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, fetch_header);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)transfer);
+    // Deadlines come from the shared policy even on a fresh handle
+    const fetch_policy_t* policy = &fetch_client()->policy;
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, policy->connect_timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, policy->timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    if (client != NULL) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, client->share);
+        curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, (long)FETCH_DNS_CACHE_SECONDS);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    }
+}
+
+static void fetch_transfer_free(fetch_transfer_t* transfer, fetch_client_t* client) {
+    fetch_buffer_put(client, transfer->scratch);
+    fetch_buffer_put(client, transfer->body);
+    cache_entry_free(&transfer->cached);
+    curl_slist_free_all(transfer->headers);
+    transfer->scratch = NULL;
+    transfer->body = NULL;
+    transfer->headers = NULL;
+}
+
+// Finish parsing a transfer into planet and bring the cache up to date:
+// a 304 serves and restamps the stale entry, a 200 replaces it. curl is
+// NULL for a transfer that was served from the cache in fetch_begin. The
+// caller counts the request, which may take several attempts.
+static int fetch_finish(fetch_transfer_t* transfer, fetch_client_t* client, CURL* curl, CURLcode result,
+                        planet_t* planet, fetch_stats_t* stats) {
+    cache_t* cache = client != NULL ? client->cache : NULL;
+    long status = 0;
+    if (curl == NULL) {
+        stats->cache_hits += result == CURLE_OK;
+    } else if (result != CURLE_OK) {
+        fprintf(stderr, "%s: %s\n", transfer->url, curl_easy_strerror(result));
+    } else {
+        long connections = 0;
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connections);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        stats->connections += connections;
+    }
+
+    // A fresh hit or a 304 is answered by the cache entry, a 200 has
+    // already gone through the parser
+    int parsed = -1;
+    if ((curl == NULL && result == CURLE_OK) || (status == 304 && transfer->cached.body != NULL)) {
+        parsed = planet_from_json(transfer->cached.body, planet);
+    } else if (status == 200) {
+        parsed = planet_reader_finish(&transfer->reader, &transfer->stream);
+        *planet = transfer->planet;
+    } else if (status != 0) {
+        fprintf(stderr, "%s: HTTP %ld\n", transfer->url, status);
+    }
+
+    if (parsed == 0 && cache != NULL && status == 304) {
+        cache_store(cache, transfer->url, transfer->cached.body, transfer->cached.size,
+                    transfer->cached.etag, transfer->cached.last_modified);
+        stats->cache_revalidated++;
+    } else if (parsed == 0 && cache != NULL && status == 200) {
+        cache_store(cache, transfer->url, transfer->body->data, transfer->body->size,
+                    transfer->etag, transfer->last_modified);
+        stats->cache_misses++;
+    }
+    for (int i = 0; i < 2; i++) {
+        buffer_t* buffer = i == 0 ? transfer->scratch : transfer->body;
+        if (buffer != NULL) {
+            stats->reallocs += buffer->reallocs;
+            stats->bytes_copied += buffer->copied;
+        }
+    }
+    fetch_transfer_free(transfer, client);
+    return parsed;
+}
+
+// Worth another attempt: no answer in time, a dropped or refused
+// connection, a cut-short body, or the server asking to back off
+static int fetch_retryable(CURL* curl, CURLcode result) {
+    long status = 0;
+    switch (result) {
+    case CURLE_OK:
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        return status == 429 || status == 500 || status == 502 || status == 503 || status == 504;
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_PARTIAL_FILE:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Jittered exponential backoff before retry number retry (from 1): a
+// random point in the upper half of FETCH_BACKOFF_MS doubled per retry, so
+// clients that failed together don't come back together
+static double fetch_backoff(int retry, unsigned* seed) {
+    double limit = FETCH_BACKOFF_MS;
+    for (int i = 1; i < retry && limit < FETCH_BACKOFF_MAX_MS; i++) {
+        limit *= 2;
+    }
+    limit = limit < FETCH_BACKOFF_MAX_MS ? limit : FETCH_BACKOFF_MAX_MS;
+    // xorshift32
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return limit * (0.5 + 0.5 * (*seed / 4294967296.0)) / 1000;
+}
+
+static unsigned fetch_seed(void) {
+    unsigned seed = (unsigned)(bench_now() * 1e6);
+    return seed != 0 ? seed : 1;
+}
+
+static void fetch_latency_record(fetch_client_t* client, double seconds) {
+    pthread_mutex_lock(&client->latency_lock);
+    client->latencies[client->latency_count++ % FETCH_LATENCY_SAMPLES] = seconds;
+    pthread_mutex_unlock(&client->latency_lock);
+}
+
+static int fetch_compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Seconds before a request is hedged, 0 for never: the fixed delay, or
+// the p95 of recent attempts once there are enough of them
+static double fetch_hedge_delay(fetch_client_t* client) {
+    if (client->policy.hedge_ms >= 0) {
+        return client->policy.hedge_ms / 1000;
+    }
+    double sorted[FETCH_LATENCY_SAMPLES];
+    pthread_mutex_lock(&client->latency_lock);
+    size_t n = client->latency_count < FETCH_LATENCY_SAMPLES ? client->latency_count : FETCH_LATENCY_SAMPLES;
+    memcpy(sorted, client->latencies, n * sizeof(double));
+    pthread_mutex_unlock(&client->latency_lock);
+    if (n < FETCH_LATENCY_MIN_SAMPLES) {
+        return 0;
+    }
+    qsort(sorted, n, sizeof(double), fetch_compare_doubles);
+    return sorted[(n * 95 + 99) / 100 - 1];
+}
+
+int fetch_planet(fetch_client_t* client, const char* planet_name, planet_t* planet, fetch_stats_t* stats) {
+    double start = bench_now();
+    fetch_stats_t totals = {0};
+    const fetch_policy_t* policy = &fetch_client()->policy;
+    unsigned seed = fetch_seed();
+    struct curl_slist *headers = client != NULL ? client->headers : curl_slist_append(NULL, FETCH_KEY_HEADER);
+    CURL *curl = client != NULL ? client->easy : curl_easy_init();
+    int parsed = -1;
+    for (int attempt = 0;; attempt++) {
+        fetch_transfer_t transfer;
+        int begun = fetch_begin(&transfer, client, planet_name);
+        if (begun == 1) {
+            parsed = fetch_finish(&transfer, client, NULL, CURLE_OK, planet, &totals);
+            break;
+        }
+        if (curl == NULL || begun < 0) {
+            fprintf(stderr, "HTTP request failed\n");
+            fetch_transfer_free(&transfer, client);
+            break;
+        }
+        fetch_setup(curl, client, headers, &transfer);
+        double wait = fetch_quota_reserve(&fetch_client()->quota);
+        if (wait > 0) {
+            totals.queued++;
+            totals.queued_seconds += wait;
+            bench_sleep(wait);
+        }
+        double started = bench_now();
+        CURLcode result = curl_easy_perform(curl);
+        int retryable = fetch_retryable(curl, result);
+        parsed = fetch_finish(&transfer, client, curl, result, planet, &totals);
+        if (parsed == 0) {
+            fetch_latency_record(fetch_client(), bench_now() - started);
+        }
+        if (parsed == 0 || !retryable || attempt == policy->retries) {
+            break;
+        }
+        totals.retries++;
+        bench_sleep(fetch_backoff(attempt + 1, &seed));
+    }
+    if (client == NULL) {
+        curl_easy_cleanup(curl);
+        curl_slist_free_all(headers);
+    }
+
+    totals.requests = 1;
+    totals.failed = parsed != 0;
+    totals.seconds = bench_now() - start;
+    if (stats != NULL) {
+        *stats = totals;
+    }
+    return parsed;
+}
+
+// One try at a request of a batch: its first attempt, a retry, or a hedge
+// racing the attempt in flight
+typedef struct FetchAttempt {
+    fetch_transfer_t transfer;
+    CURL *handle;   // NULL when not in flight
+    size_t index;   // the request it belongs to
+    int hedge;
+    double started;
+    double send_at; // when it queued for the rate limit, the time its token is due; 0 once sent
+} fetch_attempt_t;
+
+typedef struct FetchRequest {
+    double started;  // first attempt
+    double retry_at; // end of the backoff before the next attempt, 0 for none
+    int retries;
+    int in_flight;   // attempts, 2 while a hedge races the original
+    int hedged;      // the attempt in flight already has a hedge
+    int done;
+} fetch_request_t;
+
+typedef struct FetchBatch {
+    fetch_client_t *client;
+    CURLM *multi;
+    const char **names;
+    planet_t *out;
+    int *ok;
+    double *latency;
+    fetch_attempt_t *attempts; // two per request: [2i] the attempt, [2i + 1] its hedge
+    fetch_request_t *requests;
+    int pipewait;              // wait to multiplex on a sibling's connection
+    size_t active;             // requests started and not done
+    double hedge_after;        // seconds, 0 for no hedging
+    unsigned seed;
+    fetch_stats_t totals;
+} fetch_batch_t;
+
+static void fetch_request_done(fetch_batch_t* batch, size_t i, int parsed) {
+    batch->requests[i].done = 1;
+    batch->ok[i] = parsed == 0;
+    if (batch->latency != NULL) {
+        batch->latency[i] = bench_now() - batch->requests[i].started;
+    }
+    batch->totals.requests++;
+    batch->totals.failed += parsed != 0;
+    batch->active--;
+}
+
+// Stop an attempt that lost its race, or one still queued; its response is
+// never looked at
+static void fetch_attempt_cancel(fetch_batch_t* batch, fetch_attempt_t* attempt) {
+    curl_multi_remove_handle(batch->multi, attempt->handle);
+    curl_easy_cleanup(attempt->handle);
+    attempt->handle = NULL;
+    fetch_transfer_free(&attempt->transfer, batch->client);
+    batch->requests[attempt->index].in_flight--;
+}
+
+// An attempt came back: the first good answer wins and cancels its rival,
+// and once every attempt has failed the request is retried or given up on
+static void fetch_attempt_done(fetch_batch_t* batch, fetch_attempt_t* attempt, CURLcode result) {
+    size_t i = attempt->index;
+    fetch_request_t* request = &batch->requests[i];
+    int retryable = fetch_retryable(attempt->handle, result);
+    int parsed = fetch_finish(&attempt->transfer, batch->client, attempt->handle, result, &batch->out[i],
+                              &batch->totals);
+    curl_multi_remove_handle(batch->multi, attempt->handle);
+    curl_easy_cleanup(attempt->handle);
+    attempt->handle = NULL;
+    request->in_flight--;
+
+    if (parsed == 0) {
+        fetch_latency_record(batch->client, bench_now() - attempt->started);
+        batch->totals.hedges_won += attempt->hedge;
+        fetch_attempt_t* rival = &batch->attempts[2 * i + !attempt->hedge];
+        if (rival->handle != NULL) {
+            fetch_attempt_cancel(batch, rival);
+        }
+        fetch_request_done(batch, i, 0);
+    } else if (request->in_flight > 0) {
+        // the other copy may still answer
+    } else if (retryable && request->retries < batch->client->policy.retries) {
+        request->retries++;
+        request->retry_at = bench_now() + fetch_backoff(request->retries, &batch->seed);
+        request->hedged = 0;
+        batch->totals.retries++;
+    } else {
+        fetch_request_done(batch, i, -1);
+    }
+}
+
+// Start an attempt on its own easy handle. A fresh cache hit, or an
+// attempt that can't start, is settled on the spot.
+static void fetch_attempt_start(fetch_batch_t* batch, size_t i, int hedge) {
+    fetch_attempt_t* attempt = &batch->attempts[2 * i + hedge];
+    fetch_request_t* request = &batch->requests[i];
+    fetch_client_t* client = batch->client;
+    // A hedge is a spare request, only sent while the quota has room
+    if (hedge && !fetch_quota_try(&client->quota)) {
+        return;
+    }
+    if (hedge) {
+        batch->totals.hedges++;
+    }
+    int begun = fetch_begin(&attempt->transfer, client, batch->names[i]);
+    attempt->index = i;
+    attempt->hedge = hedge;
+    attempt->started = bench_now();
+    if (begun == 1) {
+        // Another process may have refreshed the entry while we waited
+        fetch_attempt_t* rival = &batch->attempts[2 * i + !hedge];
+        if (rival->handle != NULL) {
+            fetch_attempt_cancel(batch, rival);
+        }
+        fetch_request_done(batch, i, fetch_finish(&attempt->transfer, client, NULL, CURLE_OK, &batch->out[i],
+                                                  &batch->totals));
+        return;
+    }
+    attempt->handle = begun == 0 ? curl_easy_init() : NULL;
+    if (attempt->handle == NULL) {
+        fetch_finish(&attempt->transfer, client, NULL, CURLE_FAILED_INIT, &batch->out[i], &batch->totals);
+        if (request->in_flight == 0) {
+            fetch_request_done(batch, i, -1);
+        }
+        return;
+    }
+    fetch_setup(attempt->handle, client, client->headers, &attempt->transfer);
+    curl_easy_setopt(attempt->handle, CURLOPT_PIPEWAIT, (long)batch->pipewait);
+    curl_easy_setopt(attempt->handle, CURLOPT_PRIVATE, (void*)attempt);
+    request->in_flight++;
+    // Fresh cache hits took no token; a request that has to wait for one
+    // is sent from fetch_batch_timers
+    double wait = hedge ? 0 : fetch_quota_reserve(&client->quota);
+    attempt->send_at = wait > 0 ? attempt->started + wait : 0;
+    if (wait > 0) {
+        batch->totals.queued++;
+        batch->totals.queued_seconds += wait;
+    } else {
+        curl_multi_add_handle(batch->multi, attempt->handle);
+    }
+}
+
+// Send queued attempts and fire retries and hedges that are due, for the
+// requests from first to last; returns the seconds until the next one is
+// due, or limit if none is sooner
+static double fetch_batch_timers(fetch_batch_t* batch, size_t first, size_t last, double limit) {
+    double now = bench_now();
+    double wait = limit;
+    for (size_t i = first; i < last; i++) {
+        fetch_request_t* request = &batch->requests[i];
+        if (request->done) {
+            continue;
+        }
+        if (request->retry_at > 0) {
+            if (request->retry_at <= now) {
+                request->retry_at = 0;
+                fetch_attempt_start(batch, i, 0);
+            } else {
+                wait = request->retry_at - now < wait ? request->retry_at - now : wait;
+            }
+            continue;
+        }
+        fetch_attempt_t* attempt = &batch->attempts[2 * i];
+        if (attempt->handle != NULL && attempt->send_at > 0) {
+            if (attempt->send_at <= now) {
+                attempt->send_at = 0;
+                attempt->started = now;
+                curl_multi_add_handle(batch->multi, attempt->handle);
+            } else {
+                wait = attempt->send_at - now < wait ? attempt->send_at - now : wait;
+                continue;
+            }
+        }
+        if (batch->hedge_after <= 0 || request->hedged || attempt->handle == NULL) {
+            continue;
+        }
+        double due = attempt->started + batch->hedge_after;
+        if (due <= now) {
+            request->hedged = 1;
+            fetch_attempt_start(batch, i, 1);
+        } else {
+            wait = due - now < wait ? due - now : wait;
+        }
+    }
+    return wait;
+}
+
+size_t fetch_planet_list(const char* names[], size_t n, planet_t out[], int ok[], fetch_stats_t* stats) {
+    return fetch_planet_batch(names, n, n, out, ok, NULL, stats);
+}
+
+// Every named request goes out, whatever else is in flight
+static size_t fetch_batch_send(const char* names[], size_t n, size_t concurrency, planet_t out[], int ok[],
+                               double latency[], fetch_stats_t* stats) {
+    double start = bench_now();
+    fetch_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.client = fetch_client();
+    batch.names = names;
+    batch.out = out;
+    batch.ok = ok;
+    batch.latency = latency;
+    batch.attempts = calloc(2 * n, sizeof(fetch_attempt_t));
+    batch.requests = calloc(n, sizeof(fetch_request_t));
+    batch.multi = curl_multi_init();
+    batch.hedge_after = fetch_hedge_delay(batch.client);
+    batch.seed = fetch_seed();
+    // Only HTTPS can negotiate HTTP/2, and only siblings can share its
+    // connection. Waiting for one otherwise just costs a round trip, and
+    // a handle waiting on another thread's connection is never woken.
+    batch.pipewait = n > 1 && strncmp(batch.client->api_url, "https://", 8) == 0;
+    for (size_t i = 0; i < n; i++) {
+        ok[i] = 0;
+        if (latency != NULL) {
+            latency[i] = 0;
+        }
+    }
+    if (batch.attempts == NULL || batch.requests == NULL || batch.multi == NULL) {
+        fprintf(stderr, "cannot start %zu requests\n", n);
+        batch.totals.requests = batch.totals.failed = n;
+        goto done;
+    }
+    concurrency = concurrency > 0 ? concurrency : 1;
+
+    // Fresh cache entries need no request. The rest wait for the first
+    // connection and multiplex on it instead of opening one each.
+    curl_multi_setopt(batch.multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    size_t first = 0; // requests before this one are all done
+    size_t next = 0;
+    while (batch.active > 0 || next < n) {
+        for (; batch.active < concurrency && next < n; next++) {
+            batch.requests[next].started = bench_now();
+            batch.active++;
+            fetch_attempt_start(&batch, next, 0);
+        }
+        int running = 0;
+        size_t active = batch.active;
+        CURLMcode code = curl_multi_perform(batch.multi, &running);
+        CURLMsg* message;
+        int pending;
+        while (code == CURLM_OK && (message = curl_multi_info_read(batch.multi, &pending)) != NULL) {
+            if (message->msg == CURLMSG_DONE) {
+                fetch_attempt_t* attempt;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char**)&attempt);
+                fetch_attempt_done(&batch, attempt, message->data.result);
+            }
+        }
+        // Retries and hedges scheduled just now count towards the wait
+        while (first < next && batch.requests[first].done) {
+            first++;
+        }
+        double wait = fetch_batch_timers(&batch, first, next, FETCH_POLL_MS / 1000.0);
+        // A slot that just came free is refilled before waiting
+        int refill = batch.active < active && next < n;
+        if (code == CURLM_OK && !refill && batch.active > 0) {
+            code = curl_multi_poll(batch.multi, NULL, 0, (int)(1000 * wait) + 1, NULL);
+        }
+        if (code != CURLM_OK) {
+            fprintf(stderr, "curl_multi failed: %s\n", curl_multi_strerror(code));
+            break;
+        }
+    }
+
+done:
+    for (size_t i = 0; batch.attempts != NULL && i < 2 * n; i++) {
+        if (batch.attempts[i].handle != NULL) {
+            // Still in flight when the multi loop gave up early
+            fetch_attempt_cancel(&batch, &batch.attempts[i]);
+        }
+    }
+    if (batch.multi != NULL) {
+        curl_multi_cleanup(batch.multi);
+    }
+    free(batch.requests);
+    free(batch.attempts);
+
+    fetch_stats_t totals = batch.totals;
+    totals.seconds = bench_now() - start;
+    if (totals.requests < n) {
+        totals.failed += n - totals.requests;
+        totals.requests = n;
+    }
+    if (stats != NULL) {
+        *stats = totals;
+    }
+    return totals.failed;
+}
+
+// The flight for a planet, joined or started under flight_lock. *leader is
+// set when this caller started it and has to send the request. NULL when
+// the name is too long to match on (and for the API) or there is no memory
+// for a flight; the request is then sent without one.
+static fetch_flight_t* fetch_flight_join(fetch_client_t* client, const char* planet_name, int* leader) {
+    char name[FETCH_FLIGHT_NAME_SIZE];
+    size_t length = strlen(planet_name);
+    *leader = 1;
+    if (length >= sizeof(name)) {
+        return NULL;
+    }
+    for (size_t i = 0; i <= length; i++) {
+        name[i] = (char)tolower((unsigned char)planet_name[i]);
+    }
+
+    fetch_flight_t* flight = client->flights;
+    while (flight != NULL && strcmp(flight->name, name) != 0) {
+        flight = flight->next;
+    }
+    *leader = flight == NULL;
+    if (*leader) {
+        flight = calloc(1, sizeof(fetch_flight_t));
+        if (flight == NULL) {
+            return NULL;
+        }
+        memcpy(flight->name, name, length + 1);
+        flight->next = client->flights;
+        client->flights = flight;
+    }
+    flight->waiters++;
+    return flight;
+}
+
+size_t fetch_planet_batch(const char* names[], size_t n, size_t concurrency, planet_t out[], int ok[],
+                          double latency[], fetch_stats_t* stats) {
+    fetch_client_t* client = fetch_client();
+    if (!client->coalesce || n == 0) {
+        return fetch_batch_send(names, n, concurrency, out, ok, latency, stats);
+    }
+
+    fetch_flight_t** flights = malloc(n * sizeof(fetch_flight_t*));
+    int* leads = malloc(n * sizeof(int));
+    size_t* slots = malloc(n * sizeof(size_t));
+    const char** sent = malloc(n * sizeof(const char*));
+    planet_t* sent_out = malloc(n * sizeof(planet_t));
+    int* sent_ok = malloc(n * sizeof(int));
+    double* sent_latency = malloc(n * sizeof(double));
+    if (!flights || !leads || !slots || !sent || !sent_out || !sent_ok || !sent_latency) {
+        free(flights);
+        free(leads);
+        free(slots);
+        free(sent);
+        free(sent_out);
+        free(sent_ok);
+        free(sent_latency);
+        return fetch_batch_send(names, n, concurrency, out, ok, latency, stats);
+    }
+
+    // Join the requests already in flight, ours included when a name
+    // repeats, and send the rest
+    double start = bench_now();
+    size_t count = 0;
+    pthread_mutex_lock(&client->flight_lock);
+    for (size_t i = 0; i < n; i++) {
+        flights[i] = fetch_flight_join(client, names[i], &leads[i]);
+        if (leads[i]) {
+            slots[count] = i;
+            sent[count++] = names[i];
+        }
+    }
+    pthread_mutex_unlock(&client->flight_lock);
+
+    fetch_stats_t totals = {0};
+    if (count > 0) {
+        fetch_batch_send(sent, count, concurrency, sent_out, sent_ok, sent_latency, &totals);
+    }
+
+    // Publish our results before waiting on anyone else's, so two batches
+    // waiting on each other's flights can't deadlock
+    pthread_mutex_lock(&client->flight_lock);
+    for (size_t k = 0; k < count; k++) {
+        size_t i = slots[k];
+        out[i] = sent_out[k];
+        ok[i] = sent_ok[k];
+        if (latency != NULL) {
+            latency[i] = sent_latency[k];
+        }
+        fetch_flight_t* flight = flights[i];
+        if (flight != NULL) {
+            flight->planet = sent_out[k];
+            flight->result = sent_ok[k] ? 0 : -1;
+            flight->done = 1;
+            fetch_flight_t** link = &client->flights;
+            while (*link != flight) {
+                link = &(*link)->next;
+            }
+            *link = flight->next;
+        }
+    }
+    pthread_cond_broadcast(&client->flight_done);
+
+    for (size_t i = 0; i < n; i++) {
+        fetch_flight_t* flight = flights[i];
+        if (flight == NULL) {
+            continue;
+        }
+        if (!leads[i]) {
+            while (!flight->done) {
+                pthread_cond_wait(&client->flight_done, &client->flight_lock);
+            }
+            out[i] = flight->planet;
+            ok[i] = flight->result == 0;
+            if (latency != NULL) {
+                latency[i] = bench_now() - start;
+            }
+            totals.requests++;
+            totals.failed += flight->result != 0;
+            totals.coalesced++;
+        }
+        // The last one out frees it
+        if (--flight->waiters == 0) {
+            free(flight);
+        }
+    }
+    pthread_mutex_unlock(&client->flight_lock);
+
+    free(flights);
+    free(leads);
+    free(slots);
+    free(sent);
+    free(sent_out);
+    free(sent_ok);
+    free(sent_latency);
+
+    totals.seconds = bench_now() - start;
+    if (stats != NULL) {
+        *stats = totals;
+    }
+    return totals.failed;
+}
+
+static void fetch_stats_add(fetch_stats_t* total, const fetch_stats_t* stats) {
+    total->seconds += stats->seconds;
+    total->requests += stats->requests;
+    total->failed += stats->failed;
+    total->connections += stats->connections;
+    total->cache_hits += stats->cache_hits;
+    total->cache_revalidated += stats->cache_revalidated;
+    total->cache_misses += stats->cache_misses;
+    total->reallocs += stats->reallocs;
+    total->bytes_copied += stats->bytes_copied;
+    total->retries += stats->retries;
+    total->hedges += stats->hedges;
+    total->hedges_won += stats->hedges_won;
+    total->coalesced += stats->coalesced;
+    total->queued += stats->queued;
+    total->queued_seconds += stats->queued_seconds;
+}
+
+// "fetch-bench [rounds]": the eight planets one request after another on
+// fresh handles (the old behaviour), then on the shared client, then all at
+// once on the multi interface, all bypassing the cache. The last pass is the
+// multi interface again with the cache.
+int fetch_bench_command(int argc, char* argv[]) {
+    static const char* names[NUM_PLANETS] = {"Mercury", "Venus", "Earth", "Mars",
+                                             "Jupiter", "Saturn", "Uranus", "Neptune"};
+    static const char* labels[4] = {"fresh", "shared", "multi", "cached"};
+    int rounds = argc > 1 ? atoi(argv[1]) : 3;
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: planets fetch-bench [rounds]\n");
+        return 1;
+    }
+
+    fetch_client_t* client = fetch_client();
+    cache_t* cache = client->cache;
+    planet_t planets[NUM_PLANETS];
+    int ok[NUM_PLANETS];
+    fetch_stats_t totals[4];
+    memset(totals, 0, sizeof(totals));
+    for (int r = 0; r < rounds; r++) {
+        client->cache = NULL;
+        for (int mode = 0; mode < 2; mode++) {
+            for (int i = 0; i < NUM_PLANETS; i++) {
+                fetch_stats_t stats;
+                fetch_planet(mode == 0 ? NULL : client, names[i], &planets[i], &stats);
+                fetch_stats_add(&totals[mode], &stats);
+            }
+        }
+        fetch_stats_t stats;
+        fetch_planet_list(names, NUM_PLANETS, planets, ok, &stats);
+        fetch_stats_add(&totals[2], &stats);
+
+        client->cache = cache;
+        if (cache != NULL) {
+            fetch_planet_list(names, NUM_PLANETS, planets, ok, &stats);
+            fetch_stats_add(&totals[3], &stats);
+        }
+    }
+
+    printf("%d rounds of %d planets from %s\n", rounds, NUM_PLANETS, client->api_url);
+    int failed = 0;
+    for (int mode = 0; mode < (cache != NULL ? 4 : 3); mode++) {
+        size_t requests = totals[mode].requests > 0 ? totals[mode].requests : 1;
+        printf("%-8s %10.2f ms per round, %3ld new connections, %zu failed, %zu retries, %.2f reallocs and %.0f bytes copied per request",
+               labels[mode], 1000 * totals[mode].seconds / rounds, totals[mode].connections, totals[mode].failed,
+               totals[mode].retries,
+               (double)totals[mode].reallocs / requests, (double)totals[mode].bytes_copied / requests);
+        if (mode == 3) {
+            printf(", %zu hits, %zu revalidated, %zu misses in %s", totals[mode].cache_hits,
+                   totals[mode].cache_revalidated, totals[mode].cache_misses, cache->dir);
+        }
+        printf("\n");
+        failed |= totals[mode].failed != 0;
+    }
+    printf("%zu receive buffers allocated for the pool\n", client->buffers.created);
+    return failed;
+}
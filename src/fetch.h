@@ -0,0 +1,152 @@
+#ifndef FETCH_H
+#define FETCH_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "planets.h"
+#include "cache.h"
+#include "buffer.h"
+
+#define FETCH_API_KEY "V4hB8TpUJAg1cV1+J5/DVA==iHCe8S41JONK282u"
+#ifndef FETCH_API_URL
+#define FETCH_API_URL "https://api.api-ninjas.com/v1/planets?name="
+#endif
+// Overrides FETCH_API_URL at run time, e.g. to point at "planets mock-api"
+#define FETCH_API_URL_ENV "PLANETS_API_URL"
+#define FETCH_URL_SIZE 256
+
+// Seconds an address stays in the DNS cache
+#define FETCH_DNS_CACHE_SECONDS 600
+
+// Most a Content-Length header may pre-size a body by; a larger body grows
+// past it by doubling as it arrives
+#define FETCH_PRESIZE_MAX (4u << 20)
+
+// Request policy defaults, overridden by PLANETS_CONNECT_TIMEOUT_MS,
+// PLANETS_TIMEOUT_MS, PLANETS_RETRIES and PLANETS_HEDGE ("off", "p95" or a
+// delay in milliseconds)
+#define FETCH_CONNECT_TIMEOUT_MS 2000
+#define FETCH_TIMEOUT_MS 5000
+#define FETCH_RETRIES 2
+#define FETCH_BACKOFF_MS 100      // first retry waits 50-100 ms, doubling after that
+#define FETCH_BACKOFF_MAX_MS 2000
+// Recent request latencies kept for the p95 hedge delay, and how many are
+// needed before it is trusted
+#define FETCH_LATENCY_SAMPLES 128
+#define FETCH_LATENCY_MIN_SAMPLES 20
+// Longest planet name that in-flight requests are matched on
+#define FETCH_FLIGHT_NAME_SIZE 64
+
+typedef struct FetchStats {
+    double seconds;   // wall time from the first request to the last response
+    size_t requests;
+    size_t failed;
+    long connections; // new connections opened, 0 when every request reused one
+    size_t cache_hits;        // served from a fresh cache entry, no request
+    size_t cache_revalidated; // stale entry confirmed by a 304
+    size_t cache_misses;      // downloaded and stored
+    size_t reallocs;          // receive buffer reallocations
+    size_t bytes_copied;      // bytes written into receive buffers, including moves
+    size_t retries;           // attempts repeated after a timeout, reset or 429/5xx
+    size_t hedges;            // duplicate requests fired for a slow attempt
+    size_t hedges_won;        // duplicates that answered first
+    size_t coalesced;         // calls answered by another caller's request
+    size_t queued;            // attempts held back for the rate limit
+    double queued_seconds;    // total time they were held back
+} fetch_stats_t;
+
+// Deadlines, retries and hedging for every request. A failed attempt is
+// retried when the failure looks transient, after a jittered exponential
+// backoff. A hedge is a second copy of a request still unanswered after
+// hedge_ms; whichever copy answers first is used and the other cancelled.
+typedef struct FetchPolicy {
+    long connect_timeout_ms;
+    long timeout_ms;          // whole transfer, connecting included
+    int retries;              // extra attempts per request
+    double hedge_ms;          // 0 for no hedging, < 0 for the recent p95
+} fetch_policy_t;
+
+// Token bucket in front of the API key's quota: rate requests per second
+// on average, up to burst at once. A request with no token left is queued
+// until its token comes due rather than failed. Tokens are handed out in
+// the order they were asked for, so tokens goes negative while requests
+// are queued. Set with PLANETS_RATE_LIMIT and PLANETS_RATE_BURST.
+typedef struct FetchQuota {
+    pthread_mutex_t lock;
+    double rate;     // 0 for no limit
+    double burst;
+    double tokens;
+    double updated;  // bench_now() of the last refill
+} fetch_quota_t;
+
+// A request other callers can wait on instead of repeating it
+typedef struct FetchFlight {
+    struct FetchFlight *next;
+    char name[FETCH_FLIGHT_NAME_SIZE]; // lower case
+    planet_t planet;
+    int result;
+    int done;
+    size_t waiters;
+} fetch_flight_t;
+
+// Process-wide HTTP client. Responses come from the on-disk cache when it
+// has them. Every request goes through the share handle, so open
+// connections, resolved addresses and TLS sessions outlive the easy handle
+// that created them. Serial requests also reuse one easy handle, so
+// they must come from one thread at a time. Response bodies are received
+// into buffers recycled from a pool.
+typedef struct FetchClient {
+    CURLSH *share;
+    CURL *easy;
+    struct curl_slist *headers;
+    cache_t *cache;           // NULL when caching is off
+    cache_t cache_storage;
+    buffer_pool_t buffers;
+    char api_url[FETCH_URL_SIZE]; // the planet name is appended to this
+    fetch_policy_t policy;
+    pthread_mutex_t latency_lock;
+    double latencies[FETCH_LATENCY_SAMPLES]; // ring of recent successful attempts
+    size_t latency_count;                    // samples ever recorded
+    fetch_quota_t quota;
+    pthread_mutex_t flight_lock;
+    pthread_cond_t flight_done;
+    fetch_flight_t *flights;                 // requests in flight, by name
+    int coalesce;                            // 0 to send every request, for the benchmarks
+    pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+} fetch_client_t;
+
+// The client, created on first use and cleaned up at exit
+fetch_client_t* fetch_client(void);
+
+// Change the rate limit, rate 0 to lift it; the bucket starts full
+void fetch_quota_set(fetch_client_t* client, double rate, double burst);
+
+// Fill planet from an API response, -1 when a field is missing
+int planet_from_json(const char* text, planet_t* planet);
+
+// One planet on the client's easy handle, or on a fresh unshared handle
+// (new connection, DNS lookup and TLS handshake, no cache) when client is
+// NULL. Retried like any request, but never hedged.
+int fetch_planet(fetch_client_t* client, const char* planet_name, planet_t* planet, fetch_stats_t* stats);
+
+// Fetch the n named planets concurrently: every request is added to one
+// curl multi handle and they share (over HTTP/2, multiplex on) a single
+// connection. ok[i] is set to 1 for every planet that was filled in.
+// Returns the number of failed requests.
+size_t fetch_planet_list(const char* names[], size_t n, planet_t out[], int ok[], fetch_stats_t* stats);
+
+// Same, but with at most concurrency requests in flight; each one that
+// finishes makes room for the next. Hedges don't count against the limit.
+// latency, when not NULL, gets the seconds from each request being started
+// to its planet being parsed, retries and backoff included.
+// Single flight: a planet that another call (on any thread, or earlier in
+// names) is already fetching isn't requested again; it waits for that
+// request and gets a copy of its result, counted in stats->coalesced.
+size_t fetch_planet_batch(const char* names[], size_t n, size_t concurrency, planet_t out[], int ok[],
+                          double latency[], fetch_stats_t* stats);
+
+// "fetch-bench [rounds]": fresh and shared serial requests against the multi interface
+int fetch_bench_command(int argc, char* argv[]);
+
+#endif
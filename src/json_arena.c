@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "json_arena.h"
+#include "buffer.h"
+#include "mock.h"
+#include "bench.h"
+
+// Block header, padded so the bytes after it stay aligned
+#define JSON_ARENA_HEADER \
+    ((sizeof(json_arena_block_t) + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1))
+// A parse tree takes roughly this many times the size of its text
+#define JSON_ARENA_TEXT_FACTOR 4
+
+static pthread_once_t json_arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t json_arena_key; // arena of the parse running on this thread
+static pthread_key_t json_heap_key;  // heap allocation counter of this thread
+
+static json_arena_block_t* json_arena_block(json_arena_t* arena, size_t size) {
+    json_arena_block_t* block = malloc(JSON_ARENA_HEADER + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->size = size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->mallocs++;
+    return block;
+}
+
+static void* json_arena_take(json_arena_t* arena, size_t size) {
+    size = (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+    json_arena_block_t* block = arena->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        // Doubling keeps the number of blocks logarithmic in the tree size
+        size_t grow = block != NULL ? 2 * block->size : JSON_ARENA_MIN_BLOCK;
+        block = json_arena_block(arena, grow > size ? grow : size);
+        if (block == NULL) {
+            return NULL;
+        }
+    }
+    void* pointer = (char*)block + JSON_ARENA_HEADER + block->used;
+    block->used += size;
+    arena->allocations++;
+    arena->bytes += size;
+    return pointer;
+}
+
+static void* json_arena_malloc_hook(size_t size) {
+    json_arena_t* arena = pthread_getspecific(json_arena_key);
+    if (arena != NULL) {
+        return json_arena_take(arena, size);
+    }
+    size_t* count = pthread_getspecific(json_heap_key);
+    if (count != NULL) {
+        (*count)++;
+    }
+    return malloc(size);
+}
+
+// Arena memory is only given back by reset and free
+static void json_arena_free_hook(void* pointer) {
+    if (pthread_getspecific(json_arena_key) == NULL) {
+        free(pointer);
+    }
+}
+
+static void json_arena_install(void) {
+    pthread_key_create(&json_arena_key, NULL);
+    pthread_key_create(&json_heap_key, free);
+    cJSON_Hooks hooks = {json_arena_malloc_hook, json_arena_free_hook};
+    cJSON_InitHooks(&hooks);
+}
+
+void json_arena_init(json_arena_t* arena) {
+    memset(arena, 0, sizeof(*arena));
+}
+
+cJSON* json_arena_parse(json_arena_t* arena, const char* text) {
+    pthread_once(&json_arena_once, json_arena_install);
+    if (arena->blocks == NULL) {
+        size_t guess = JSON_ARENA_TEXT_FACTOR * strlen(text);
+        json_arena_block(arena, guess > JSON_ARENA_MIN_BLOCK ? guess : JSON_ARENA_MIN_BLOCK);
+    }
+    pthread_setspecific(json_arena_key, arena);
+    cJSON* json = cJSON_Parse(text);
+    pthread_setspecific(json_arena_key, NULL);
+    return json;
+}
+
+void json_arena_reset(json_arena_t* arena) {
+    json_arena_block_t* block = arena->blocks;
+    arena->allocations = 0;
+    arena->bytes = 0;
+    if (block == NULL) {
+        return;
+    }
+    if (block->next == NULL) {
+        block->used = 0;
+        return;
+    }
+    size_t total = 0;
+    while (block != NULL) {
+        json_arena_block_t* next = block->next;
+        total += block->size;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    json_arena_block(arena, total);
+}
+
+void json_arena_free(json_arena_t* arena) {
+    json_arena_block_t* block = arena->blocks;
+    while (block != NULL) {
+        json_arena_block_t* next = block->next;
+        free(block);
+        block = next;
+    }
+    json_arena_init(arena);
+}
+
+void json_heap_count_begin(void) {
+    pthread_once(&json_arena_once, json_arena_install);
+    size_t* count = pthread_getspecific(json_heap_key);
+    if (count == NULL && (count = malloc(sizeof(size_t))) != NULL) {
+        pthread_setspecific(json_heap_key, count);
+    }
+    if (count != NULL) {
+        *count = 0;
+    }
+}
+
+size_t json_heap_count_end(void) {
+    size_t* count = pthread_getspecific(json_heap_key);
+    size_t result = count != NULL ? *count : 0;
+    pthread_setspecific(json_heap_key, NULL);
+    free(count);
+    return result;
+}
+
+// Bodies in the catalog schema until the text reaches size bytes
+static int json_bench_document(buffer_t* text, size_t size) {
+    char body[320];
+    if (buffer_append(text, "[", 1) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; text->size < size; i++) {
+        int n = snprintf(body, sizeof(body),
+                         "%s{\"name\": \"body %zu\", \"semi_major_axis\": %.6f, \"eccentricity\": %.6f, "
+                         "\"period\": %.3f, \"perihelion_day\": %.5f, \"inclination\": %.4f, "
+                         "\"ascending_node\": %.4f, \"argument_of_perihelion\": %.4f}",
+                         i > 0 ? ", " : "", i, 0.5 + (double)(i % 997) / 31, (double)(i % 89) / 100,
+                         200.0 + (double)(i % 5000), 2460000.5 + (double)(i % 3000),
+                         (double)(i % 180) / 7, (double)(i % 360), (double)(i % 359));
+        if (buffer_append(text, body, (size_t)n) != 0) {
+            return -1;
+        }
+    }
+    return buffer_append(text, "]", 1);
+}
+
+// Parse + free rounds times on the heap, then in one arena; 0 when both
+// trees had the same number of top-level items
+static int json_bench_run(const char* label, const char* text, long rounds) {
+    json_heap_count_begin();
+    int items = -1;
+    double start = bench_now();
+    for (long r = 0; r < rounds; r++) {
+        cJSON* json = cJSON_Parse(text);
+        items = json != NULL ? cJSON_GetArraySize(json) : -1;
+        cJSON_Delete(json);
+    }
+    double heap_seconds = bench_now() - start;
+    size_t heap_mallocs = json_heap_count_end();
+
+    json_arena_t arena;
+    json_arena_init(&arena);
+    int arena_items = -1;
+    size_t allocations = 0;
+    start = bench_now();
+    for (long r = 0; r < rounds; r++) {
+        cJSON* json = json_arena_parse(&arena, text);
+        arena_items = json != NULL ? cJSON_GetArraySize(json) : -1;
+        allocations = arena.allocations;
+        json_arena_reset(&arena);
+    }
+    double arena_seconds = bench_now() - start;
+    size_t arena_mallocs = arena.mallocs;
+    json_arena_free(&arena);
+
+    size_t length = strlen(text);
+    printf("%s: %zu bytes, %d items, %ld rounds, %zu cJSON allocations per parse\n", label, length, items, rounds,
+           allocations);
+    printf("  heap   %12.3f us per parse+delete, %10.1f mallocs per parse, %8.1f MB/s\n",
+           1e6 * heap_seconds / rounds, (double)heap_mallocs / rounds, length * rounds / heap_seconds / 1e6);
+    printf("  arena  %12.3f us per parse+reset,  %10.1f mallocs per parse, %8.1f MB/s (%zu mallocs in all)\n",
+           1e6 * arena_seconds / rounds, (double)arena_mallocs / rounds, length * rounds / arena_seconds / 1e6,
+           arena_mallocs);
+    return items >= 0 && items == arena_items ? 0 : -1;
+}
+
+int json_bench_command(int argc, char* argv[]) {
+    double megabytes = argc > 1 ? atof(argv[1]) : 16;
+    long rounds = argc > 2 ? atol(argv[2]) : 5;
+    if (megabytes <= 0 || rounds <= 0) {
+        fprintf(stderr, "usage: planets json-bench [megabytes] [rounds]\n");
+        return 1;
+    }
+
+    buffer_t text;
+    buffer_init(&text);
+    if (json_bench_document(&text, (size_t)(megabytes * 1e6)) != 0) {
+        fprintf(stderr, "out of memory\n");
+        buffer_free(&text);
+        return 1;
+    }
+    int failed = json_bench_run("planets response", mock_recording("earth"), rounds * 20000);
+    failed |= json_bench_run("catalog document", text.data, rounds);
+    buffer_free(&text);
+    if (failed) {
+        fprintf(stderr, "the heap and arena trees differ\n");
+    }
+    return failed ? 1 : 0;
+}
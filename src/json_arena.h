@@ -0,0 +1,50 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <stddef.h>
+#include "cJSON.h"
+
+// Bump allocator for cJSON parse trees. While json_arena_parse runs, every
+// node, key and string cJSON allocates on that thread is carved out of the
+// arena's blocks; frees are no-ops, and the tree goes away with the blocks
+// in one json_arena_reset or json_arena_free instead of a cJSON_Delete
+// walk. The cJSON hooks are installed once for the process and fall back
+// to malloc/free on threads with no arena parse running, so cJSON keeps
+// working everywhere else.
+#define JSON_ARENA_ALIGN 16
+#define JSON_ARENA_MIN_BLOCK 65536
+
+typedef struct JsonArenaBlock {
+    struct JsonArenaBlock *next;
+    size_t size;
+    size_t used;
+} json_arena_block_t; // followed by size bytes, JSON_ARENA_ALIGN aligned
+
+typedef struct JsonArena {
+    json_arena_block_t *blocks; // newest first
+    size_t allocations;         // requests from cJSON since the last reset
+    size_t mallocs;             // blocks taken from the heap, ever
+    size_t bytes;               // bytes handed to cJSON since the last reset
+} json_arena_t;
+
+void json_arena_init(json_arena_t* arena);
+
+// Parse text into the arena, NULL when it is not valid JSON. The tree must
+// not be passed to cJSON_Delete; it lives until the next reset or free.
+cJSON* json_arena_parse(json_arena_t* arena, const char* text);
+
+// Drop every tree parsed so far. The blocks are kept, merged into one, so
+// the next parse of the same size needs no allocation at all.
+void json_arena_reset(json_arena_t* arena);
+void json_arena_free(json_arena_t* arena);
+
+// Count the allocations cJSON makes on this thread outside any arena,
+// for comparison; end returns the count since begin
+void json_heap_count_begin(void);
+size_t json_heap_count_end(void);
+
+// "json-bench [megabytes] [rounds]": cJSON parse + delete on the heap vs
+// in an arena, for a planets response and a large document
+int json_bench_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,321 @@
+#include <string.h>
+#include "json_stream.h"
+
+// What is being read
+enum { TOKEN_NONE, TOKEN_STRING, TOKEN_NUMBER, TOKEN_LITERAL };
+
+// What a container expects next
+enum {
+    STATE_KEY_OR_END,   // just after {
+    STATE_KEY,          // after a comma in an object
+    STATE_COLON,
+    STATE_VALUE,        // member value
+    STATE_ITEM_OR_END,  // just after [
+    STATE_ITEM,         // after a comma in an array
+    STATE_COMMA_OR_END,
+};
+
+void json_stream_init(json_stream_t* stream, const json_stream_handler_t* handler, buffer_t* scratch) {
+    memset(stream, 0, sizeof(*stream));
+    stream->handler = *handler;
+    stream->value = scratch;
+    buffer_clear(scratch);
+}
+
+static int expects_value(const json_stream_t* stream) {
+    if (stream->depth == 0) {
+        return !stream->done;
+    }
+    int state = stream->states[stream->depth - 1];
+    return state == STATE_VALUE || state == STATE_ITEM_OR_END || state == STATE_ITEM;
+}
+
+static int expects_key(const json_stream_t* stream) {
+    int state = stream->depth > 0 ? stream->states[stream->depth - 1] : -1;
+    return state == STATE_KEY_OR_END || state == STATE_KEY;
+}
+
+// Records are the objects of a top-level array, or the top-level object
+static int record_level(const json_stream_t* stream) {
+    return stream->containers[0] == '[' ? 1 : 0;
+}
+
+// A value, scalar or container, just ended; scalars inside a record are reported
+static void value_done(json_stream_t* stream, const char* scalar, int is_string) {
+    if (stream->depth == 0) {
+        stream->done = 1;
+        return;
+    }
+    int level = stream->depth - 1;
+    if (scalar != NULL && level == record_level(stream) && stream->containers[level] == '{' &&
+        stream->handler.field != NULL) {
+        stream->handler.field(stream->handler.user, stream->key, scalar, is_string);
+    }
+    stream->states[level] = STATE_COMMA_OR_END;
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static int valid_number(const char* text) {
+    const char* p = text + (*text == '-');
+    if (*p == '0') {
+        p++;
+    } else if (*p >= '1' && *p <= '9') {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    } else {
+        return 0;
+    }
+    if (*p == '.') {
+        if (!(*++p >= '0' && *p <= '9')) {
+            return 0;
+        }
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == 'e' || *p == 'E') {
+        p += p[1] == '+' || p[1] == '-';
+        if (!(*++p >= '0' && *p <= '9')) {
+            return 0;
+        }
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    return *p == 0;
+}
+
+static int append_utf8(buffer_t* buffer, unsigned code) {
+    char out[4];
+    size_t n;
+    if (code < 0x80) {
+        out[0] = (char)code;
+        n = 1;
+    } else if (code < 0x800) {
+        out[0] = (char)(0xC0 | code >> 6);
+        out[1] = (char)(0x80 | (code & 0x3F));
+        n = 2;
+    } else if (code < 0x10000) {
+        out[0] = (char)(0xE0 | code >> 12);
+        out[1] = (char)(0x80 | (code >> 6 & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+        n = 3;
+    } else {
+        out[0] = (char)(0xF0 | code >> 18);
+        out[1] = (char)(0x80 | (code >> 12 & 0x3F));
+        out[2] = (char)(0x80 | (code >> 6 & 0x3F));
+        out[3] = (char)(0x80 | (code & 0x3F));
+        n = 4;
+    }
+    return buffer_append(buffer, out, n);
+}
+
+// A high surrogate not followed by its low half becomes U+FFFD
+static int flush_surrogate(json_stream_t* stream) {
+    if (stream->high == 0) {
+        return 0;
+    }
+    stream->high = 0;
+    return append_utf8(stream->value, 0xFFFD);
+}
+
+// One character of a \ escape, -1 when it is not valid JSON
+static int string_escape(json_stream_t* stream, char c) {
+    static const char plain[] = "\"\\/bfnrt";
+    static const char meaning[] = "\"\\/\b\f\n\r\t";
+    if (stream->escape == 1) {
+        const char* found = c != 0 ? strchr(plain, c) : NULL;
+        if (c == 'u') {
+            stream->escape = 2;
+            stream->code = 0;
+            return 0;
+        }
+        stream->escape = 0;
+        return found != NULL && flush_surrogate(stream) == 0
+                   ? buffer_append(stream->value, &meaning[found - plain], 1) : -1;
+    }
+
+    int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10
+              : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    if (digit < 0) {
+        return -1;
+    }
+    stream->code = stream->code << 4 | (unsigned)digit;
+    if (++stream->escape < 6) {
+        return 0;
+    }
+    stream->escape = 0;
+    unsigned code = stream->code;
+    if (code >= 0xDC00 && code <= 0xDFFF && stream->high != 0) {
+        code = 0x10000 + ((stream->high - 0xD800) << 10) + (code - 0xDC00);
+        stream->high = 0;
+        return append_utf8(stream->value, code);
+    }
+    if (flush_surrogate(stream) != 0) {
+        return -1;
+    }
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        stream->high = code;
+        return 0;
+    }
+    return append_utf8(stream->value, code >= 0xDC00 && code <= 0xDFFF ? 0xFFFD : code);
+}
+
+// The string token ended at its closing quote
+static int string_done(json_stream_t* stream) {
+    if (flush_surrogate(stream) != 0) {
+        return -1;
+    }
+    const char* text = stream->value->data != NULL ? stream->value->data : "";
+    if (expects_key(stream)) {
+        size_t n = strlen(text);
+        n = n < JSON_STREAM_KEY_SIZE - 1 ? n : JSON_STREAM_KEY_SIZE - 1;
+        memcpy(stream->key, text, n);
+        stream->key[n] = 0;
+        stream->states[stream->depth - 1] = STATE_COLON;
+    } else {
+        value_done(stream, text, 1);
+    }
+    return 0;
+}
+
+static int bare_character(int token, char c) {
+    if (token == TOKEN_NUMBER) {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+    return c >= 'a' && c <= 'z';
+}
+
+// A number or literal ended just before the current character
+static int bare_done(json_stream_t* stream) {
+    const char* text = stream->value->data != NULL ? stream->value->data : "";
+    int valid = stream->token == TOKEN_NUMBER
+                    ? valid_number(text)
+                    : strcmp(text, "true") == 0 || strcmp(text, "false") == 0 || strcmp(text, "null") == 0;
+    stream->token = TOKEN_NONE;
+    if (!valid) {
+        return -1;
+    }
+    value_done(stream, text, 0);
+    return 0;
+}
+
+// Structural character or the start of a token
+static int structure(json_stream_t* stream, char c) {
+    int level = stream->depth - 1;
+    int state = level >= 0 ? stream->states[level] : -1;
+    switch (c) {
+    case ' ': case '\t': case '\n': case '\r':
+        return 0;
+    case '{': case '[':
+        if (!expects_value(stream) || stream->depth == JSON_STREAM_DEPTH) {
+            return -1;
+        }
+        stream->containers[stream->depth] = c;
+        stream->states[stream->depth] = c == '{' ? STATE_KEY_OR_END : STATE_ITEM_OR_END;
+        stream->depth++;
+        return 0;
+    case '}': case ']':
+        if (level < 0 || stream->containers[level] != (c == '}' ? '{' : '[') ||
+            (state != STATE_COMMA_OR_END && state != STATE_KEY_OR_END && state != STATE_ITEM_OR_END)) {
+            return -1;
+        }
+        stream->depth--;
+        if (c == '}' && level == record_level(stream)) {
+            stream->records++;
+            if (stream->handler.record != NULL) {
+                stream->handler.record(stream->handler.user);
+            }
+        }
+        value_done(stream, NULL, 0);
+        return 0;
+    case ',':
+        if (state != STATE_COMMA_OR_END) {
+            return -1;
+        }
+        stream->states[level] = stream->containers[level] == '{' ? STATE_KEY : STATE_ITEM;
+        return 0;
+    case ':':
+        if (state != STATE_COLON) {
+            return -1;
+        }
+        stream->states[level] = STATE_VALUE;
+        return 0;
+    case '"':
+        if (!expects_value(stream) && !expects_key(stream)) {
+            return -1;
+        }
+        stream->token = TOKEN_STRING;
+        buffer_clear(stream->value);
+        return 0;
+    default:
+        if (!expects_value(stream)) {
+            return -1;
+        }
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            stream->token = TOKEN_NUMBER;
+        } else if (c >= 'a' && c <= 'z') {
+            stream->token = TOKEN_LITERAL;
+        } else {
+            return -1;
+        }
+        buffer_clear(stream->value);
+        return buffer_append(stream->value, &c, 1);
+    }
+}
+
+int json_stream_feed(json_stream_t* stream, const char* data, size_t size) {
+    size_t i = 0;
+    while (i < size && !stream->failed) {
+        char c = data[i];
+        int result = 0;
+        if (stream->token == TOKEN_STRING && stream->escape == 0) {
+            // Copy the run of plain characters in one go
+            size_t run = i;
+            while (run < size && data[run] != '"' && data[run] != '\\' && (unsigned char)data[run] >= 0x20) {
+                run++;
+            }
+            if (run > i) {
+                result = flush_surrogate(stream) == 0 ? buffer_append(stream->value, data + i, run - i) : -1;
+                i = run;
+            } else if (c == '"') {
+                stream->token = TOKEN_NONE;
+                result = string_done(stream);
+                i++;
+            } else if (c == '\\') {
+                stream->escape = 1;
+                i++;
+            } else {
+                result = -1; // unescaped control character
+            }
+        } else if (stream->token == TOKEN_STRING) {
+            result = string_escape(stream, c);
+            i++;
+        } else if (stream->token == TOKEN_NUMBER || stream->token == TOKEN_LITERAL) {
+            size_t run = i;
+            while (run < size && bare_character(stream->token, data[run])) {
+                run++;
+            }
+            if (run > i) {
+                result = buffer_append(stream->value, data + i, run - i);
+                i = run;
+            } else {
+                result = bare_done(stream); // c is looked at again as structure
+            }
+        } else {
+            result = structure(stream, c);
+            i++;
+        }
+        stream->failed = result != 0;
+    }
+    stream->offset += i;
+    return stream->failed ? -1 : 0;
+}
+
+int json_stream_finish(json_stream_t* stream) {
+    if (!stream->failed && (stream->token == TOKEN_NUMBER || stream->token == TOKEN_LITERAL)) {
+        stream->failed = bare_done(stream) != 0;
+    }
+    return stream->failed || !stream->done || stream->token != TOKEN_NONE ? -1 : 0;
+}
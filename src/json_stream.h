@@ -0,0 +1,51 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stddef.h>
+#include "buffer.h"
+
+// Push-style JSON parser: the document is fed in chunks of any size, as
+// they arrive, and nothing but the value being read is kept. Records are
+// the objects of a top-level array (or the top-level object itself); their
+// scalar members are handed to field() as text and record() is called
+// once each record is closed. Members of nested containers are checked
+// for syntax but not reported.
+#define JSON_STREAM_DEPTH 32
+#define JSON_STREAM_KEY_SIZE 64 // longer keys are cut short
+
+typedef struct JsonStreamHandler {
+    // value is NUL terminated: the unescaped string, the number as
+    // written, or true / false / null
+    void (*field)(void* user, const char* key, const char* value, int is_string);
+    void (*record)(void* user);
+    void *user;
+} json_stream_handler_t;
+
+typedef struct JsonStream {
+    json_stream_handler_t handler;
+    int token;       // what is being read, see json_stream.c
+    int escape;      // position within a \ escape, 0 outside one
+    unsigned code;   // \u code unit being read
+    unsigned high;   // pending high surrogate
+    int depth;
+    char containers[JSON_STREAM_DEPTH]; // '[' or '{'
+    int states[JSON_STREAM_DEPTH];
+    int done;        // the top-level value is complete
+    int failed;
+    char key[JSON_STREAM_KEY_SIZE];
+    buffer_t *value; // scratch, never longer than the longest single value
+    size_t records;
+    size_t offset;   // bytes consumed, for error messages
+} json_stream_t;
+
+// scratch holds the value being read; it belongs to the caller so that it
+// can come from a buffer pool
+void json_stream_init(json_stream_t* stream, const json_stream_handler_t* handler, buffer_t* scratch);
+
+// Consume the next chunk, -1 once the document is malformed
+int json_stream_feed(json_stream_t* stream, const char* data, size_t size);
+
+// End of input, -1 unless exactly one complete value was fed
+int json_stream_finish(json_stream_t* stream);
+
+#endif
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "julian.h"
+#include "bench.h"
+
+// Julian Day Number at noon of a Gregorian date (Fliegel and Van Flandern).
+// a is 1 for January and February, which are counted as months 10 and 11 of
+// the previous year so the leap day falls at the end of the cycle.
+static inline int64_t julian_day_number(int64_t year, int64_t month, int64_t day) {
+    int64_t a = (14 - month) / 12;
+    int64_t y = year + 4800 - a;
+    int64_t m = month + 12 * a - 3;
+    return day + (153 * m + 2) / 5 + 365 * y + y / 4 - y / 100 + y / 400 - 32045;
+}
+
+double julian_date(int year, int month, int day, int hour, int minute, double second) {
+    // The day number starts at noon, the calendar day at midnight
+    return julian_day_number(year, month, day) - 0.5 +
+           (hour * 3600 + minute * 60 + second) / SECONDS_PER_DAY;
+}
+
+void julian_calendar(double jd, int* year, int* month, int* day, int* hour, int* minute) {
+    // Minutes since the midnight that starts the Julian day number's date
+    int64_t minutes = (int64_t)floor((jd + 0.5) * 1440 + 0.5);
+    int64_t number = minutes / 1440;
+    int64_t rest = minutes - number * 1440;
+
+    // Inverse of julian_day_number
+    int64_t l = number + 68569;
+    int64_t n = 4 * l / 146097;
+    l = l - (146097 * n + 3) / 4;
+    int64_t i = 4000 * (l + 1) / 1461001;
+    l = l - 1461 * i / 4 + 31;
+    int64_t j = 80 * l / 2447;
+    *day = (int)(l - 2447 * j / 80);
+    l = j / 11;
+    *month = (int)(j + 2 - 12 * l);
+    *year = (int)(100 * (n - 49) + i + l);
+    *hour = (int)(rest / 60);
+    *minute = (int)(rest % 60);
+}
+
+double julian_from_unix(double seconds) {
+    return JULIAN_UNIX_EPOCH + seconds / SECONDS_PER_DAY;
+}
+
+void julian_dates(const int32_t* year, const int32_t* month, const int32_t* day,
+                  const double* day_fraction, double* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = julian_day_number(year[i], month[i], day[i]) - 0.5 + day_fraction[i];
+    }
+}
+
+void julian_from_unix_batch(const int64_t* seconds, double* out, size_t n) {
+    // Whole days and the remainder are converted separately so the result
+    // keeps sub-millisecond precision
+    for (size_t i = 0; i < n; i++) {
+        int64_t days = seconds[i] / 86400;
+        int64_t rest = seconds[i] - days * 86400;
+        out[i] = (JULIAN_UNIX_EPOCH + days) + rest * (1 / SECONDS_PER_DAY);
+    }
+}
+
+// "julian-bench [count]": random calendar dates and timestamps
+int julian_bench_command(int argc, char* argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    if (n == 0) {
+        fprintf(stderr, "usage: planets julian-bench [count]\n");
+        return 1;
+    }
+
+    int32_t* year = malloc(n * sizeof(int32_t));
+    int32_t* month = malloc(n * sizeof(int32_t));
+    int32_t* day = malloc(n * sizeof(int32_t));
+    double* fraction = malloc(n * sizeof(double));
+    int64_t* seconds = malloc(n * sizeof(int64_t));
+    double* out = malloc(n * sizeof(double));
+    if (!year || !month || !day || !fraction || !seconds || !out) {
+        fprintf(stderr, "not enough memory for %zu dates\n", n);
+        free(year); free(month); free(day); free(fraction); free(seconds); free(out);
+        return 1;
+    }
+
+    srand(1306);
+    for (size_t i = 0; i < n; i++) {
+        year[i] = 1800 + rand() % 400;
+        month[i] = 1 + rand() % 12;
+        day[i] = 1 + rand() % 28;
+        fraction[i] = (double)rand() / RAND_MAX;
+        seconds[i] = (int64_t)rand() * 4;
+    }
+
+    double start = bench_now();
+    julian_dates(year, month, day, fraction, out, n);
+    bench_report("calendar -> JD", (double)n, "dates", bench_now() - start);
+
+    start = bench_now();
+    julian_from_unix_batch(seconds, out, n);
+    bench_report("unix time -> JD", (double)n, "timestamps", bench_now() - start);
+
+    // Spot checks against published values
+    printf("\nJD of 01/01/2000 12:00 = %.4f (expected 2451545.0)\n", julian_date(2000, 1, 1, 12, 0, 0));
+    printf("JD of unix time 0      = %.4f (expected 2440587.5)\n", julian_from_unix(0));
+
+    free(year);
+    free(month);
+    free(day);
+    free(fraction);
+    free(seconds);
+    free(out);
+    return 0;
+}
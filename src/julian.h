@@ -0,0 +1,30 @@
+#ifndef JULIAN_H
+#define JULIAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Julian Date of the Unix epoch, 1970-01-01 00:00 UTC
+#define JULIAN_UNIX_EPOCH 2440587.5
+#define SECONDS_PER_DAY 86400.0
+
+// Julian Date (days, fractional) of a Gregorian calendar date at
+// hour:minute:second. Integer arithmetic only, no branches, valid for any
+// year after -4800.
+double julian_date(int year, int month, int day, int hour, int minute, double second);
+
+// Gregorian calendar date and time of a Julian Date, rounded to the minute
+void julian_calendar(double jd, int* year, int* month, int* day, int* hour, int* minute);
+
+// Julian Date of a Unix timestamp in seconds
+double julian_from_unix(double seconds);
+
+// Batch conversions, laid out so the loops vectorize
+void julian_dates(const int32_t* year, const int32_t* month, const int32_t* day,
+                  const double* day_fraction, double* out, size_t n);
+void julian_from_unix_batch(const int64_t* seconds, double* out, size_t n);
+
+// "julian-bench" mode: conversions per second for both batch paths
+int julian_bench_command(int argc, char* argv[]);
+
+#endif
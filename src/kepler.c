@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "kepler.h"
+#include "planets.h"
+#include "bench.h"
+
+// Constants shared by the vector kernels
+#define KEPLER_ROUND_MAGIC 6755399441055744.0 // 1.5 * 2^52, rounds to nearest integer
+#define KEPLER_2_OVER_PI 0.63661977236758134308
+#define KEPLER_1_OVER_2PI 0.15915494309189533577
+#define KEPLER_PIO2_HI 1.57079632673412561417e+00 // first 33 bits of PI/2
+#define KEPLER_PIO2_LO 6.07710050650619224932e-11 // PI/2 - KEPLER_PIO2_HI
+#define KEPLER_2PI_HI (4 * KEPLER_PIO2_HI)
+#define KEPLER_2PI_LO (4 * KEPLER_PIO2_LO)
+
+// Scalar reference: same starter and iteration count as the vector kernels
+void kepler_solve_scalar(const double* M, const double* ecc, double* E,
+                         double* sinE, double* cosE, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        double turns = nearbyint(M[i] * KEPLER_1_OVER_2PI);
+        double m = (M[i] - turns * KEPLER_2PI_HI) - turns * KEPLER_2PI_LO;
+        double e = ecc[i];
+        double x = m + 0.85 * e * (m >= 0 ? 1.0 : -1.0);
+
+        for (int k = 0; k < KEPLER_ITERATIONS; k++) {
+            double s = sin(x);
+            double c = cos(x);
+            double f = x - e * s - m;
+            double df = 1.0 - e * c;
+            x = x - f * df / (df * df - 0.5 * f * e * s);
+        }
+
+        if (sinE != NULL) {
+            sinE[i] = sin(x);
+            cosE[i] = cos(x);
+        }
+        E[i] = x + turns * KEPLER_2PI_HI + turns * KEPLER_2PI_LO;
+    }
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define KEPLER_HAVE_X86 1
+
+// SSE2 is part of the x86-64 baseline, no target attribute needed
+#define KERNEL_SUFFIX sse2
+#define KERNEL_TARGET
+#define KERNEL_LANES 2
+#include "kepler_kernel.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_TARGET
+#undef KERNEL_LANES
+
+#define KERNEL_SUFFIX avx2
+#define KERNEL_TARGET __attribute__((target("avx2,fma")))
+#define KERNEL_LANES 4
+#include "kepler_kernel.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_TARGET
+#undef KERNEL_LANES
+
+#define KERNEL_SUFFIX avx512
+#define KERNEL_TARGET __attribute__((target("avx512f,avx512dq")))
+#define KERNEL_LANES 8
+#include "kepler_kernel.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_TARGET
+#undef KERNEL_LANES
+#endif
+
+// Precomputed E(M, e) table: D = E - M and its derivatives over M in
+// [0, PI] and e in [0, KEPLER_TABLE_MAX_E], scaled by the grid spacing so an
+// interpolation is a plain bicubic Hermite patch. The M axis is uniform in
+// s = sqrt(M / PI), which packs nodes near perihelion where E bends sharply
+// for high eccentricities. Odd symmetry E(-M) = -E(M) covers the other half.
+typedef struct KeplerNode {
+    double d;   // E - M
+    double dm;  // d(E - M)/ds * grid step in s
+    double de;  // dE/de * grid step in e
+    double dme; // d2E/dsde * both steps
+} kepler_node_t;
+
+static kepler_node_t kepler_table[KEPLER_TABLE_E + 1][KEPLER_TABLE_M + 1];
+static pthread_once_t kepler_table_once = PTHREAD_ONCE_INIT;
+
+static void kepler_table_build(void) {
+    double step_s = 1.0 / KEPLER_TABLE_M;
+    double step_e = KEPLER_TABLE_MAX_E / KEPLER_TABLE_E;
+
+    for (int j = 0; j <= KEPLER_TABLE_E; j++) {
+        for (int i = 0; i <= KEPLER_TABLE_M; i++) {
+            double s_node = i * step_s;
+            double m = PI * s_node * s_node;
+            double step_m = 2 * PI * s_node * step_s; // dM/ds * step
+            double e = j * step_e;
+            double E, s, c;
+            kepler_solve_scalar(&m, &e, &E, &s, &c, 1);
+
+            double g = 1 - e * c;       // dM/dE
+            double dE_de = s / g;
+            kepler_table[j][i].d = E - m;
+            kepler_table[j][i].dm = (1 / g - 1) * step_m;
+            kepler_table[j][i].de = dE_de * step_e;
+            kepler_table[j][i].dme = (c - e * s * dE_de) / (g * g) * step_m * step_e;
+        }
+    }
+}
+
+// Table lookup with bicubic Hermite interpolation. Eccentricities above
+// KEPLER_TABLE_MAX_E are off the table and get the scalar solver instead.
+void kepler_solve_table(const double* M, const double* ecc, double* E,
+                        double* sinE, double* cosE, size_t n) {
+    pthread_once(&kepler_table_once, kepler_table_build);
+    const double scale_e = KEPLER_TABLE_E / KEPLER_TABLE_MAX_E;
+
+    for (size_t k = 0; k < n; k++) {
+        if (ecc[k] > KEPLER_TABLE_MAX_E) {
+            kepler_solve_scalar(&M[k], &ecc[k], &E[k], sinE != NULL ? &sinE[k] : NULL,
+                                cosE != NULL ? &cosE[k] : NULL, 1);
+            continue;
+        }
+        double turns = nearbyint(M[k] * KEPLER_1_OVER_2PI);
+        double m = (M[k] - turns * KEPLER_2PI_HI) - turns * KEPLER_2PI_LO;
+        double sign = m < 0 ? -1.0 : 1.0;
+        m = fabs(m);
+
+        double u = sqrt(m * (1 / PI)) * KEPLER_TABLE_M;
+        double v = ecc[k] * scale_e;
+        int i = (int)u;
+        int j = (int)v;
+        if (i >= KEPLER_TABLE_M) {
+            i = KEPLER_TABLE_M - 1;
+        }
+        if (j >= KEPLER_TABLE_E) {
+            // e == KEPLER_TABLE_MAX_E, the last row
+            j = KEPLER_TABLE_E - 1;
+            v = KEPLER_TABLE_E;
+        }
+        double t = u - i;
+        double w = v - j;
+
+        // Cubic Hermite basis: value at 0, slope at 0, value at 1, slope at 1
+        double t2 = t * t, t3 = t2 * t;
+        double w2 = w * w, w3 = w2 * w;
+        double ht[4] = {2 * t3 - 3 * t2 + 1, t3 - 2 * t2 + t, -2 * t3 + 3 * t2, t3 - t2};
+        double hw[4] = {2 * w3 - 3 * w2 + 1, w3 - 2 * w2 + w, -2 * w3 + 3 * w2, w3 - w2};
+
+        const kepler_node_t* n00 = &kepler_table[j][i];
+        const kepler_node_t* n01 = &kepler_table[j][i + 1];
+        const kepler_node_t* n10 = &kepler_table[j + 1][i];
+        const kepler_node_t* n11 = &kepler_table[j + 1][i + 1];
+
+        double low = hw[0] * (ht[0] * n00->d + ht[1] * n00->dm + ht[2] * n01->d + ht[3] * n01->dm)
+                   + hw[1] * (ht[0] * n00->de + ht[1] * n00->dme + ht[2] * n01->de + ht[3] * n01->dme);
+        double high = hw[2] * (ht[0] * n10->d + ht[1] * n10->dm + ht[2] * n11->d + ht[3] * n11->dm)
+                    + hw[3] * (ht[0] * n10->de + ht[1] * n10->dme + ht[2] * n11->de + ht[3] * n11->dme);
+
+        double x = sign * (m + low + high);
+        if (sinE != NULL) {
+            sinE[k] = sin(x);
+            cosE[k] = cos(x);
+        }
+        E[k] = x + turns * KEPLER_2PI_HI + turns * KEPLER_2PI_LO;
+    }
+}
+
+typedef struct KeplerSolver {
+    const char* name;
+    kepler_fn solve;
+    int supported;
+    int automatic; // eligible for the CPU dispatch, the table is opt-in
+} kepler_solver_t;
+
+static kepler_solver_t solvers[] = {
+#ifdef KEPLER_HAVE_X86
+    {"avx512", kepler_solve_avx512, 0, 1},
+    {"avx2", kepler_solve_avx2, 0, 1},
+    {"sse2", kepler_solve_sse2, 0, 1},
+#endif
+    {"scalar", kepler_solve_scalar, 1, 1},
+    {"table", kepler_solve_table, 1, 0},
+};
+
+#define NUM_SOLVERS (sizeof(solvers) / sizeof(solvers[0]))
+
+static kepler_solver_t* selected_solver = NULL;
+static pthread_once_t kepler_detect_once = PTHREAD_ONCE_INIT;
+
+// Runtime CPU feature detection, best solver first. PLANETS_KEPLER can
+// name a solver instead (e.g. "table" or "scalar").
+static void kepler_detect(void) {
+#ifdef KEPLER_HAVE_X86
+    __builtin_cpu_init();
+    solvers[0].supported = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+    solvers[1].supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    solvers[2].supported = 1;
+#endif
+
+    for (size_t i = 0; i < NUM_SOLVERS; i++) {
+        if (solvers[i].supported && solvers[i].automatic) {
+            selected_solver = &solvers[i];
+            break;
+        }
+    }
+
+    const char* requested = getenv("PLANETS_KEPLER");
+    if (requested != NULL) {
+        for (size_t i = 0; i < NUM_SOLVERS; i++) {
+            if (solvers[i].supported && strcmp(solvers[i].name, requested) == 0) {
+                selected_solver = &solvers[i];
+            }
+        }
+    }
+}
+
+void kepler_solve(const double* M, const double* ecc, double* E,
+                  double* sinE, double* cosE, size_t n) {
+    pthread_once(&kepler_detect_once, kepler_detect);
+    selected_solver->solve(M, ecc, E, sinE, cosE, n);
+}
+
+const char* kepler_solver_name(void) {
+    pthread_once(&kepler_detect_once, kepler_detect);
+    return selected_solver->name;
+}
+
+int kepler_use(const char* name) {
+    pthread_once(&kepler_detect_once, kepler_detect);
+    for (size_t i = 0; i < NUM_SOLVERS; i++) {
+        if (solvers[i].supported && strcmp(solvers[i].name, name) == 0) {
+            selected_solver = &solvers[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// The original one-term approximation, kept for comparison
+static void kepler_solve_approximation(const double* M, const double* ecc, double* E,
+                                       double* sinE, double* cosE, size_t n) {
+    (void)sinE;
+    (void)cosE;
+    for (size_t i = 0; i < n; i++) {
+        E[i] = M[i] + ecc[i] * sin(M[i]);
+    }
+}
+
+static double max_residual(const double* M, const double* ecc, const double* E, size_t n) {
+    double worst = 0;
+    for (size_t i = 0; i < n; i++) {
+        double residual = fabs(E[i] - ecc[i] * sin(E[i]) - M[i]);
+        if (residual > worst) {
+            worst = residual;
+        }
+    }
+    return worst;
+}
+
+static double max_difference(const double* a, const double* b, size_t n) {
+    double worst = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (fabs(a[i] - b[i]) > worst) {
+            worst = fabs(a[i] - b[i]);
+        }
+    }
+    return worst;
+}
+
+static void bench_solver(const char* name, kepler_fn solve, const double* M, const double* ecc,
+                         const double* exact, double* E, double* sinE, double* cosE, size_t n, int repeats) {
+    double start = bench_now();
+    for (int r = 0; r < repeats; r++) {
+        solve(M, ecc, E, sinE, cosE, n);
+    }
+    double elapsed = bench_now() - start;
+    printf("%-18s %8.2f ns/body   max |E - e sinE - M| = %.3e   max |E - E_exact| = %.3e rad\n",
+           name, elapsed * 1e9 / ((double)n * repeats), max_residual(M, ecc, E, n),
+           max_difference(E, exact, n));
+}
+
+// "kepler-bench [bodies] [max_eccentricity]": every supported solver against
+// the one-term approximation on random mean anomalies
+int kepler_bench_command(int argc, char* argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    double max_e = argc > 2 ? atof(argv[2]) : 0.97;
+    if (n == 0 || max_e < 0 || max_e >= 1) {
+        fprintf(stderr, "usage: planets kepler-bench [bodies] [max_eccentricity < 1]\n");
+        return 1;
+    }
+
+    double* M = malloc(n * sizeof(double));
+    double* ecc = malloc(n * sizeof(double));
+    double* E = malloc(n * sizeof(double));
+    double* sinE = malloc(n * sizeof(double));
+    double* cosE = malloc(n * sizeof(double));
+    if (!M || !ecc || !E || !sinE || !cosE) {
+        fprintf(stderr, "not enough memory for %zu bodies\n", n);
+        free(M); free(ecc); free(E); free(sinE); free(cosE);
+        return 1;
+    }
+
+    srand(1306);
+    for (size_t i = 0; i < n; i++) {
+        M[i] = 20 * PI * ((double)rand() / RAND_MAX - 0.5);
+        ecc[i] = max_e * rand() / RAND_MAX;
+    }
+
+    double* exact = malloc(n * sizeof(double));
+    if (exact == NULL) {
+        fprintf(stderr, "not enough memory for %zu bodies\n", n);
+        free(M); free(ecc); free(E); free(sinE); free(cosE);
+        return 1;
+    }
+    kepler_solve_scalar(M, ecc, exact, NULL, NULL, n);
+
+    printf("Kepler solvers on %zu bodies, e in [0, %.2f], dispatch picks %s\n\n",
+           n, max_e, kepler_solver_name());
+
+    kepler_solve_table(M, ecc, E, NULL, NULL, 0); // build the table before anything that uses it is timed
+    bench_solver("approximation", kepler_solve_approximation, M, ecc, exact, E, NULL, NULL, n, 3);
+    for (size_t i = 0; i < NUM_SOLVERS; i++) {
+        if (solvers[i].supported) {
+            bench_solver(solvers[i].name, solvers[i].solve, M, ecc, exact, E, sinE, cosE, n, 3);
+        }
+    }
+    bench_solver("table (no sin/cos)", kepler_solve_table, M, ecc, exact, E, NULL, NULL, n, 3);
+    printf("\ntable: %d x %d nodes, %zu KB\n", KEPLER_TABLE_M + 1, KEPLER_TABLE_E + 1, sizeof(kepler_table) / 1024);
+
+    free(M);
+    free(ecc);
+    free(E);
+    free(sinE);
+    free(cosE);
+    free(exact);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef KEPLER_H
+#define KEPLER_H
+
+#include <stddef.h>
+
+// Inverse-Kepler lookup table size (M steps over [0, PI], e steps), 32 bytes
+// per node so the whole table is about 500 KB
+#define KEPLER_TABLE_M 256
+#define KEPLER_TABLE_E 64
+#define KEPLER_TABLE_MAX_E 0.97
+
+// Fixed Halley iteration count, enough for e <= 0.97 from the Danby starter
+#define KEPLER_ITERATIONS 5
+
+// Solve M = E - e sin(E) for n bodies. sinE and cosE may be NULL, otherwise
+// they receive sin(E) and cos(E) so callers don't have to recompute them.
+// |M| must stay below about 6e6 rad (mean anomaly reduction limit).
+typedef void (*kepler_fn)(const double* M, const double* ecc, double* E,
+                          double* sinE, double* cosE, size_t n);
+
+// Best solver for this CPU, picked once on first use
+void kepler_solve(const double* M, const double* ecc, double* E,
+                  double* sinE, double* cosE, size_t n);
+
+// Name of the solver kepler_solve dispatches to ("avx512", "avx2", "sse2", "scalar", "table")
+const char* kepler_solver_name(void);
+
+// Make kepler_solve use a solver by name, -1 if it isn't available here.
+// The PLANETS_KEPLER environment variable does the same at startup.
+int kepler_use(const char* name);
+
+// Scalar reference solver with the same iteration count, using libm
+void kepler_solve_scalar(const double* M, const double* ecc, double* E,
+                         double* sinE, double* cosE, size_t n);
+
+// Interpolated lookup in a precomputed E(M, e) table, no iterations.
+// Rendering-grade accuracy for e up to KEPLER_TABLE_MAX_E; bodies above it
+// are solved by kepler_solve_scalar.
+void kepler_solve_table(const double* M, const double* ecc, double* E,
+                        double* sinE, double* cosE, size_t n);
+
+// "kepler-bench" mode: ns/body and max residual per solver
+int kepler_bench_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,70 @@
+// Vector Kepler kernel, included once per instruction set by kepler.c with
+//   KERNEL_SUFFIX  name suffix (sse2, avx2, ...)
+//   KERNEL_TARGET  function attribute selecting the instruction set
+//   KERNEL_LANES   doubles per vector
+// No include guard on purpose.
+
+#define KERNEL_PASTE2(a, b) a##_##b
+#define KERNEL_PASTE(a, b) KERNEL_PASTE2(a, b)
+#define KERNEL_FN(name) KERNEL_PASTE(name, KERNEL_SUFFIX)
+#define KERNEL_VEC KERNEL_FN(vdouble)
+#define KERNEL_IVEC KERNEL_FN(vlong)
+
+typedef double KERNEL_VEC __attribute__((vector_size(KERNEL_LANES * sizeof(double))));
+typedef long long KERNEL_IVEC __attribute__((vector_size(KERNEL_LANES * sizeof(long long))));
+
+#define VECTOR_FN KERNEL_FN
+#define VECTOR_REAL double
+#define VECTOR_T KERNEL_VEC
+#define VECTOR_IT KERNEL_IVEC
+#define VECTOR_TARGET KERNEL_TARGET
+#define VECTOR_PRECISE 1
+#define VECTOR_ROUND_MAGIC KEPLER_ROUND_MAGIC
+#define VECTOR_PIO2_HI KEPLER_PIO2_HI
+#define VECTOR_PIO2_LO KEPLER_PIO2_LO
+#include "kepler_vector.h"
+#undef VECTOR_FN
+#undef VECTOR_REAL
+#undef VECTOR_T
+#undef VECTOR_IT
+#undef VECTOR_TARGET
+#undef VECTOR_PRECISE
+#undef VECTOR_ROUND_MAGIC
+#undef VECTOR_PIO2_HI
+#undef VECTOR_PIO2_LO
+
+KERNEL_TARGET static void KERNEL_FN(kepler_solve)(const double* M, const double* ecc, double* E,
+                                                  double* sinE, double* cosE, size_t n) {
+    size_t i = 0;
+    for (; i + KERNEL_LANES <= n; i += KERNEL_LANES) {
+        KERNEL_VEC m, e;
+        memcpy(&m, M + i, sizeof(m));
+        memcpy(&e, ecc + i, sizeof(e));
+
+        // Reduce M to [-PI, PI], the turns are added back at the end
+        KERNEL_VEC turns = (m * KEPLER_1_OVER_2PI + KEPLER_ROUND_MAGIC) - KEPLER_ROUND_MAGIC;
+        m = (m - turns * KEPLER_2PI_HI) - turns * KEPLER_2PI_LO;
+
+        KERNEL_VEC x = KERNEL_FN(vkepler)(m, e, KEPLER_ITERATIONS);
+        if (sinE != NULL) {
+            KERNEL_VEC s, c;
+            KERNEL_FN(vsincos)(x, &s, &c);
+            memcpy(sinE + i, &s, sizeof(s));
+            memcpy(cosE + i, &c, sizeof(c));
+        }
+        x = x + turns * KEPLER_2PI_HI + turns * KEPLER_2PI_LO;
+        memcpy(E + i, &x, sizeof(x));
+    }
+
+    // Tail shorter than a vector
+    if (i < n) {
+        kepler_solve_scalar(M + i, ecc + i, E + i,
+                            sinE ? sinE + i : NULL, cosE ? cosE + i : NULL, n - i);
+    }
+}
+
+#undef KERNEL_VEC
+#undef KERNEL_IVEC
+#undef KERNEL_FN
+#undef KERNEL_PASTE
+#undef KERNEL_PASTE2
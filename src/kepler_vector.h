@@ -0,0 +1,76 @@
+// Vector sin/cos and Halley iterations for Kepler's equation, shared by the
+// Kepler kernels (kepler_kernel.h) and the propagation kernels
+// (orbits_kernel.h). Included inside a kernel once it has defined
+//   VECTOR_FN(name)     name with the kernel's suffix
+//   VECTOR_REAL         float or double
+//   VECTOR_T            vector of VECTOR_REAL
+//   VECTOR_IT           integer vector with lanes of the same width
+//   VECTOR_TARGET       function attribute selecting the instruction set
+//   VECTOR_PRECISE      1 for the polynomials double needs, 0 for float
+//   VECTOR_ROUND_MAGIC  1.5 * 2^mantissa bits, rounds to nearest integer
+//   VECTOR_PIO2_HI/LO   PI/2 split so q * VECTOR_PIO2_HI is exact
+// No include guard on purpose.
+
+#define VC(x) ((VECTOR_REAL)(x))
+
+// sin and cos of x for |x| up to a few PI: quadrant reduction with a two-part
+// PI/2, then Taylor polynomials on [-PI/4, PI/4], cut to the precision
+VECTOR_TARGET static inline void VECTOR_FN(vsincos)(VECTOR_T x, VECTOR_T* s, VECTOR_T* c) {
+    VECTOR_T q = (x * VC(0.63661977236758134308) + VECTOR_ROUND_MAGIC) - VECTOR_ROUND_MAGIC;
+    VECTOR_T r = (x - q * VECTOR_PIO2_HI) - q * VECTOR_PIO2_LO;
+    VECTOR_T r2 = r * r;
+
+#if VECTOR_PRECISE
+    VECTOR_T sp = r2 * VC(1.0 / 355687428096000.0) - VC(1.0 / 1307674368000.0);
+    sp = sp * r2 + VC(1.0 / 6227020800.0);
+    sp = sp * r2 - VC(1.0 / 39916800.0);
+    sp = sp * r2 + VC(1.0 / 362880.0);
+    sp = sp * r2 - VC(1.0 / 5040.0);
+#else
+    VECTOR_T sp = r2 * VC(1.0 / 362880.0) - VC(1.0 / 5040.0);
+#endif
+    sp = sp * r2 + VC(1.0 / 120.0);
+    sp = sp * r2 - VC(1.0 / 6.0);
+    VECTOR_T sin_r = r + r * r2 * sp;
+
+#if VECTOR_PRECISE
+    VECTOR_T cp = r2 * VC(1.0 / 20922789888000.0) - VC(1.0 / 87178291200.0);
+    cp = cp * r2 + VC(1.0 / 479001600.0);
+    cp = cp * r2 - VC(1.0 / 3628800.0);
+    cp = cp * r2 + VC(1.0 / 40320.0);
+#else
+    VECTOR_T cp = r2 * VC(-1.0 / 3628800.0) + VC(1.0 / 40320.0);
+#endif
+    cp = cp * r2 - VC(1.0 / 720.0);
+    cp = cp * r2 + VC(1.0 / 24.0);
+    cp = cp * r2 - VC(0.5);
+    VECTOR_T cos_r = VC(1.0) + r2 * cp;
+
+    // Quadrant fix-up without branches: odd quadrants swap sin and cos,
+    // bit 1 of q (and of q + 1 for cos) flips the sign
+    VECTOR_IT qi = __builtin_convertvector(q, VECTOR_IT);
+    VECTOR_T swap = __builtin_convertvector(qi & 1, VECTOR_T);
+    VECTOR_T sin_sign = VC(1.0) - VC(2.0) * __builtin_convertvector((qi >> 1) & 1, VECTOR_T);
+    VECTOR_T cos_sign = VC(1.0) - VC(2.0) * __builtin_convertvector(((qi + 1) >> 1) & 1, VECTOR_T);
+
+    *s = sin_sign * (sin_r + swap * (cos_r - sin_r));
+    *c = cos_sign * (cos_r + swap * (sin_r - cos_r));
+}
+
+// E for M already reduced to [-PI, PI]: Danby starter E0 = M + 0.85 e sign(M),
+// then a fixed number of Halley steps
+VECTOR_TARGET static inline VECTOR_T VECTOR_FN(vkepler)(VECTOR_T m, VECTOR_T e, int iterations) {
+    VECTOR_T sign = VC(-1.0) - VC(2.0) * __builtin_convertvector(m >= 0, VECTOR_T);
+    VECTOR_T x = m + VC(0.85) * e * sign;
+    VECTOR_T s, c;
+    for (int k = 0; k < iterations; k++) {
+        VECTOR_FN(vsincos)(x, &s, &c);
+        VECTOR_T f = x - e * s - m;
+        VECTOR_T df = VC(1.0) - e * c;
+        VECTOR_T d2f = e * s;
+        x = x - f * df / (df * df - VC(0.5) * f * d2f);
+    }
+    return x;
+}
+
+#undef VC
@@ -0,0 +1,720 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "mock.h"
+#include "fetch.h"
+#include "bench.h"
+
+#define MOCK_NAME_SIZE 64
+// How often the accept loop looks at the stop flag
+#define MOCK_ACCEPT_POLL_MS 100
+// Throttled bodies go out in slices of this much time
+#define MOCK_SLICE_SECONDS 0.01
+
+// Bodies in the API's format: an array holding the match, empty for none.
+// mass and radius are in Jupiter units, temperature in kelvin.
+typedef struct MockRecording {
+    const char *name;
+    const char *body;
+} mock_recording_t;
+
+static const mock_recording_t mock_recordings[] = {
+    {"mercury", "[{\"name\": \"Mercury\", \"mass\": 0.000174, \"radius\": 0.0341, \"period\": 88.0, \"semi_major_axis\": 0.387, "
+                "\"temperature\": 440.0, \"distance_light_year\": 1.6e-05, \"host_star_mass\": 1.0, \"host_star_temperature\": 6000.0}]"},
+    {"venus", "[{\"name\": \"Venus\", \"mass\": 0.00256, \"radius\": 0.0847, \"period\": 224.7, \"semi_major_axis\": 0.723, "
+              "\"temperature\": 737.0, \"distance_light_year\": 4.4e-06, \"host_star_mass\": 1.0, \"host_star_temperature\": 6000.0}]"},
+    {"earth", "[{\"name\": \"Earth\", \"mass\": 0.00315, \"radius\": 0.0892, \"period\": 365.2, \"semi_major_axis\": 1.0, "
+              "\"temperature\": 288.0, \"distance_light_year\": 1.58e-05, \"host_star_mass\": 1.0, \"host_star_temperature\": 6000.0}]"},
+    {"mars", "[{\"name\": \"Mars\", \"mass\": 0.000338, \"radius\": 0.0488, \"period\": 687.0, \"semi_major_axis\": 1.524, "
+             "\"temperature\": 210.0, \"distance_light_year\": 3.7e-05, \"host_star_mass\": 1.0, \"host_star_temperature\": 6000.0}]"},
+    {"jupiter", "[{\"name\": \"Jupiter\", \"mass\": 1.0, \"radius\": 1.0, \"period\": 4331.0, \"semi_major_axis\": 5.203, "
+                "\"temperature\": 165.0, \"distance_light_year\": 6.2e-05, \"host_star_mass\": 1.0, \"host_star_temperature\": 6000.0}]"},
+    {"saturn", "[{\"name\": \"Saturn\", \"mass\": 0.299, \"radius\": 0.843, \"period\": 10747.0, \"semi_major_axis\": 9.537, "
+               "\"temperature\": 134.0, \"distance_light_year\": 0.000136, \"host_star_mass\": 1.0, \"host_star_temperature\": 6000.0}]"},
+    {"uranus", "[{\"name\": \"Uranus\", \"mass\": 0.0457, \"radius\": 0.357, \"period\": 30589.0, \"semi_major_axis\": 19.19, "
+               "\"temperature\": 76.0, \"distance_light_year\": 0.000304, \"host_star_mass\": 1.0, \"host_star_temperature\": 6000.0}]"},
+    {"neptune", "[{\"name\": \"Neptune\", \"mass\": 0.054, \"radius\": 0.346, \"period\": 59800.0, \"semi_major_axis\": 30.07, "
+                "\"temperature\": 72.0, \"distance_light_year\": 0.000473, \"host_star_mass\": 1.0, \"host_star_temperature\": 6000.0}]"},
+};
+
+#define MOCK_RECORDINGS (sizeof(mock_recordings) / sizeof(mock_recordings[0]))
+
+const char* mock_recording(const char* name) {
+    for (size_t i = 0; i < MOCK_RECORDINGS; i++) {
+        if (strcmp(name, mock_recordings[i].name) == 0) {
+            return mock_recordings[i].body;
+        }
+    }
+    return NULL;
+}
+
+typedef struct MockConnection {
+    mock_server_t *server;
+    int socket;
+    int slot;
+    unsigned seed;
+} mock_connection_t;
+
+static int mock_send(int socket, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(socket, data, size, 0);
+        if (sent <= 0) {
+            return -1;
+        }
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return 0;
+}
+
+// Send size bytes of body at no more than bandwidth bytes per second
+static int mock_send_body(int socket, const char* body, size_t size, double bandwidth) {
+    if (bandwidth <= 0) {
+        return mock_send(socket, body, size);
+    }
+    size_t slice = (size_t)(bandwidth * MOCK_SLICE_SECONDS);
+    slice = slice > 0 ? slice : 1;
+    double start = bench_now();
+    for (size_t sent = 0; sent < size;) {
+        size_t n = size - sent < slice ? size - sent : slice;
+        if (mock_send(socket, body + sent, n) != 0) {
+            return -1;
+        }
+        sent += n;
+        bench_sleep(start + (double)sent / bandwidth - bench_now());
+    }
+    return 0;
+}
+
+// Value of the named header in a request, "" when it is absent
+static void mock_header(const char* request, const char* name, char* value, size_t size) {
+    size_t n = strlen(name);
+    value[0] = 0;
+    for (const char* line = strstr(request, "\r\n"); line != NULL; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, name, n) != 0 || line[n] != ':') {
+            continue;
+        }
+        const char* start = line + n + 1;
+        while (*start == ' ' || *start == '\t') {
+            start++;
+        }
+        size_t length = strcspn(start, "\r\n");
+        length = length < size - 1 ? length : size - 1;
+        memcpy(value, start, length);
+        value[length] = 0;
+        return;
+    }
+}
+
+// The decoded, lower-cased name= parameter of a request target; names
+// outside [a-z0-9 _-] are left empty so they can't reach the file system
+static void mock_query_name(const char* target, size_t length, char name[MOCK_NAME_SIZE]) {
+    size_t n = 0;
+    name[0] = 0;
+    const char* query = memchr(target, '?', length);
+    const char* end = target + length;
+    for (const char* p = query; p != NULL && p < end; p = memchr(p + 1, '&', (size_t)(end - p - 1))) {
+        if (end - p > 5 && strncmp(p + 1, "name=", 5) == 0) {
+            for (const char* c = p + 6; c < end && *c != '&' && n < MOCK_NAME_SIZE - 1; c++) {
+                int ch = (unsigned char)*c;
+                if (ch == '+') {
+                    ch = ' ';
+                } else if (ch == '%' && end - c > 2 && isxdigit((unsigned char)c[1]) && isxdigit((unsigned char)c[2])) {
+                    char hex[3] = {c[1], c[2], 0};
+                    ch = (int)strtol(hex, NULL, 16);
+                    c += 2;
+                }
+                ch = tolower(ch);
+                if (!(isalnum(ch) || ch == ' ' || ch == '_' || ch == '-')) {
+                    name[0] = 0;
+                    return;
+                }
+                name[n++] = (char)ch;
+            }
+            name[n] = 0;
+            return;
+        }
+    }
+}
+
+// The body for a name, malloc'd; "[]" like the API when nothing matches
+static char* mock_body(const mock_server_t* server, const char* name) {
+    const char* found = "[]";
+    if (server->options.recordings != NULL && name[0] != 0) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s.json", server->options.recordings, name);
+        FILE* file = fopen(path, "rb");
+        if (file != NULL) {
+            char* body = NULL;
+            long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+            if (size >= 0 && fseek(file, 0, SEEK_SET) == 0 && (body = malloc((size_t)size + 1)) != NULL) {
+                size_t got = fread(body, 1, (size_t)size, file);
+                body[got] = 0;
+            }
+            fclose(file);
+            return body;
+        }
+    } else {
+        for (size_t i = 0; i < MOCK_RECORDINGS; i++) {
+            if (strcmp(name, mock_recordings[i].name) == 0) {
+                found = mock_recordings[i].body;
+            }
+        }
+    }
+    char* body = malloc(strlen(found) + 1);
+    if (body != NULL) {
+        strcpy(body, found);
+    }
+    return body;
+}
+
+// FNV-1a of the body, so the tag changes exactly when the body does
+static void mock_etag(const char* body, char etag[16]) {
+    unsigned hash = 2166136261u;
+    for (const char* p = body; *p != 0; p++) {
+        hash = (hash ^ (unsigned char)*p) * 16777619u;
+    }
+    snprintf(etag, 16, "\"%08x\"", hash);
+}
+
+static int mock_status(int socket, const char* status, int keep_alive) {
+    char head[256];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                     status, keep_alive ? "keep-alive" : "close");
+    return mock_send(socket, head, (size_t)n);
+}
+
+// Answer one request, 1 to keep the connection open
+static int mock_respond(mock_connection_t* connection, const char* request) {
+    mock_server_t* server = connection->server;
+    const mock_options_t* options = &server->options;
+    size_t method = strcspn(request, " \r\n");
+    const char* target = request + method + (request[method] == ' ');
+    size_t target_length = strcspn(target, " \r\n");
+    const char* version = target + target_length + (target[target_length] == ' ');
+    char value[64];
+    mock_header(request, "connection", value, sizeof(value));
+    int keep_alive = strncmp(version, "HTTP/1.1", 8) == 0 ? strcasecmp(value, "close") != 0
+                                                          : strcasecmp(value, "keep-alive") == 0;
+
+    pthread_mutex_lock(&server->lock);
+    server->stats.requests++;
+    pthread_mutex_unlock(&server->lock);
+    if (method != 3 || strncmp(request, "GET", 3) != 0) {
+        return mock_status(connection->socket, "405 Method Not Allowed", keep_alive) == 0 && keep_alive;
+    }
+    size_t path = strcspn(target, "?");
+    if (path > target_length || path != strlen(MOCK_PATH) || strncmp(target, MOCK_PATH, path) != 0) {
+        return mock_status(connection->socket, "404 Not Found", keep_alive) == 0 && keep_alive;
+    }
+
+    int slow = (double)rand_r(&connection->seed) / ((double)RAND_MAX + 1) < options->slow_rate;
+    if (slow) {
+        pthread_mutex_lock(&server->lock);
+        server->stats.slow++;
+        pthread_mutex_unlock(&server->lock);
+    }
+    bench_sleep(options->latency_ms / 1000 * (slow ? MOCK_SLOW_FACTOR : 1));
+    double draw = (double)rand_r(&connection->seed) / ((double)RAND_MAX + 1);
+    int failure = draw < options->error_rate ? (draw < options->error_rate / 2 ? 1 : 2) : 0;
+    if (failure != 0) {
+        pthread_mutex_lock(&server->lock);
+        server->stats.errors++;
+        pthread_mutex_unlock(&server->lock);
+    }
+    if (failure == 1) {
+        return mock_status(connection->socket, "503 Service Unavailable", keep_alive) == 0 && keep_alive;
+    }
+
+    char name[MOCK_NAME_SIZE];
+    mock_query_name(target, target_length, name);
+    char* body = mock_body(server, name);
+    if (body == NULL) {
+        mock_status(connection->socket, "500 Internal Server Error", 0);
+        return 0;
+    }
+    char etag[16];
+    char match[64];
+    mock_etag(body, etag);
+    mock_header(request, "if-none-match", match, sizeof(match));
+    size_t size = strlen(body);
+    int unchanged = strcmp(match, etag) == 0 && failure == 0;
+    if (unchanged) {
+        pthread_mutex_lock(&server->lock);
+        server->stats.not_modified++;
+        pthread_mutex_unlock(&server->lock);
+    }
+
+    char head[512];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                     "ETag: %s\r\nConnection: %s\r\n\r\n",
+                     unchanged ? "304 Not Modified" : "200 OK", unchanged ? (size_t)0 : size, etag,
+                     keep_alive && failure == 0 ? "keep-alive" : "close");
+    int sent = mock_send(connection->socket, head, (size_t)n);
+    // A cut-short body: half of it, then the connection goes away
+    size_t length = unchanged ? 0 : failure == 2 ? size / 2 : size;
+    if (sent == 0) {
+        sent = mock_send_body(connection->socket, body, length, options->bandwidth);
+    }
+    free(body);
+    return sent == 0 && keep_alive && failure == 0;
+}
+
+static void* mock_connection_thread(void* arg) {
+    mock_connection_t* connection = arg;
+    mock_server_t* server = connection->server;
+    char request[MOCK_REQUEST_SIZE];
+    size_t used = 0;
+    int open = 1;
+    while (open) {
+        // Requests can be pipelined, so whatever follows one is kept
+        char* end;
+        request[used] = 0;
+        while ((end = strstr(request, "\r\n\r\n")) == NULL) {
+            ssize_t got = used < sizeof(request) - 1 ? recv(connection->socket, request + used, sizeof(request) - 1 - used, 0) : -1;
+            if (got <= 0) {
+                if (used == sizeof(request) - 1) {
+                    mock_status(connection->socket, "431 Request Header Fields Too Large", 0);
+                }
+                open = 0;
+                break;
+            }
+            used += (size_t)got;
+            request[used] = 0;
+        }
+        if (!open) {
+            break;
+        }
+        size_t length = (size_t)(end + 4 - request);
+        end[2] = 0; // keep the last header's line ending for mock_header
+        open = mock_respond(connection, request);
+        memmove(request, request + length, used - length);
+        used -= length;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    close(connection->socket);
+    server->sockets[connection->slot] = -1;
+    if (--server->active == 0) {
+        pthread_cond_broadcast(&server->idle);
+    }
+    pthread_mutex_unlock(&server->lock);
+    free(connection);
+    return NULL;
+}
+
+static void mock_accept(mock_server_t* server, int socket) {
+    mock_connection_t* connection = malloc(sizeof(mock_connection_t));
+    pthread_mutex_lock(&server->lock);
+    int slot = 0;
+    while (slot < MOCK_MAX_CONNECTIONS && server->sockets[slot] >= 0) {
+        slot++;
+    }
+    if (connection == NULL || slot == MOCK_MAX_CONNECTIONS || server->stopping) {
+        pthread_mutex_unlock(&server->lock);
+        close(socket);
+        free(connection);
+        return;
+    }
+    connection->server = server;
+    connection->socket = socket;
+    connection->slot = slot;
+    connection->seed = server->seed + (unsigned)server->stats.connections * 2654435761u;
+    server->sockets[slot] = socket;
+    server->active++;
+    server->stats.connections++;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, mock_connection_thread, connection) != 0) {
+        server->sockets[slot] = -1;
+        server->active--;
+        pthread_mutex_unlock(&server->lock);
+        close(socket);
+        free(connection);
+        return;
+    }
+    pthread_detach(thread);
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void* mock_accept_thread(void* arg) {
+    mock_server_t* server = arg;
+    struct pollfd listener = {server->listener, POLLIN, 0};
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        int stopping = server->stopping;
+        pthread_mutex_unlock(&server->lock);
+        if (stopping) {
+            break;
+        }
+        if (poll(&listener, 1, MOCK_ACCEPT_POLL_MS) <= 0) {
+            continue;
+        }
+        int socket = accept(server->listener, NULL, NULL);
+        if (socket >= 0) {
+            // Headers and body are separate writes; without this the body
+            // waits out the client's delayed ACK
+            int on = 1;
+            setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            mock_accept(server, socket);
+        }
+    }
+    return NULL;
+}
+
+int mock_start(mock_server_t* server, const mock_options_t* options) {
+    memset(server, 0, sizeof(*server));
+    server->options = *options;
+    server->seed = (unsigned)time(NULL);
+    for (int i = 0; i < MOCK_MAX_CONNECTIONS; i++) {
+        server->sockets[i] = -1;
+    }
+    // A client hanging up mid-response must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+
+    server->listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listener < 0) {
+        perror("socket");
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(server->listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)options->port);
+    socklen_t length = sizeof(address);
+    if (bind(server->listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(server->listener, MOCK_MAX_CONNECTIONS) != 0 ||
+        getsockname(server->listener, (struct sockaddr*)&address, &length) != 0) {
+        perror("mock-api");
+        close(server->listener);
+        return -1;
+    }
+    server->port = ntohs(address.sin_port);
+
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->idle, NULL);
+    if (pthread_create(&server->acceptor, NULL, mock_accept_thread, server) != 0) {
+        fprintf(stderr, "mock-api: cannot start a thread\n");
+        pthread_cond_destroy(&server->idle);
+        pthread_mutex_destroy(&server->lock);
+        close(server->listener);
+        return -1;
+    }
+    return 0;
+}
+
+void mock_stop(mock_server_t* server) {
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_mutex_unlock(&server->lock);
+    pthread_join(server->acceptor, NULL);
+    close(server->listener);
+
+    // Wake every connection thread out of recv and wait for them to go
+    pthread_mutex_lock(&server->lock);
+    for (int i = 0; i < MOCK_MAX_CONNECTIONS; i++) {
+        if (server->sockets[i] >= 0) {
+            shutdown(server->sockets[i], SHUT_RDWR);
+        }
+    }
+    while (server->active > 0) {
+        pthread_cond_wait(&server->idle, &server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+    pthread_cond_destroy(&server->idle);
+    pthread_mutex_destroy(&server->lock);
+}
+
+void mock_url(const mock_server_t* server, char* url, size_t size) {
+    snprintf(url, size, "http://127.0.0.1:%d%s?name=", server->port, MOCK_PATH);
+}
+
+// Options shared by both modes, from argv[first] on
+static void mock_parse_options(int argc, char* argv[], int first, mock_options_t* options) {
+    options->latency_ms = argc > first ? atof(argv[first]) : options->latency_ms;
+    options->bandwidth = argc > first + 1 ? atof(argv[first + 1]) * 1000 / 8 : options->bandwidth;
+    options->error_rate = argc > first + 2 ? atof(argv[first + 2]) : options->error_rate;
+    options->slow_rate = argc > first + 3 ? atof(argv[first + 3]) : options->slow_rate;
+}
+
+static int mock_options_valid(const mock_options_t* options) {
+    return options->port >= 0 && options->port <= 65535 && options->latency_ms >= 0 && options->bandwidth >= 0 &&
+           options->error_rate >= 0 && options->error_rate <= 1 && options->slow_rate >= 0 && options->slow_rate <= 1;
+}
+
+int mock_api_command(int argc, char* argv[]) {
+    mock_options_t options = {8765, 50, 0, 0, 0, NULL};
+    options.port = argc > 1 ? atoi(argv[1]) : options.port;
+    mock_parse_options(argc, argv, 2, &options);
+    options.recordings = argc > 6 ? argv[6] : NULL;
+    if (!mock_options_valid(&options)) {
+        fprintf(stderr, "usage: planets mock-api [port] [latency_ms] [bandwidth_kbps] [error_rate] [slow_rate] [recordings_dir]\n");
+        return 1;
+    }
+
+    mock_server_t server;
+    if (mock_start(&server, &options) != 0) {
+        return 1;
+    }
+    char url[FETCH_URL_SIZE];
+    mock_url(&server, url, sizeof(url));
+    printf("serving %s on %s (%.0f ms latency, %s, %.0f%% errors, %.0f%% slow)\n",
+           options.recordings != NULL ? options.recordings : "the eight planets", url, options.latency_ms,
+           options.bandwidth > 0 ? "throttled" : "unthrottled", 100 * options.error_rate, 100 * options.slow_rate);
+    printf("%s=%s ./planets fetch-bench\n", FETCH_API_URL_ENV, url);
+    fflush(stdout);
+    pthread_join(server.acceptor, NULL); // until interrupted
+    return 0;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double* sorted, size_t n, double p) {
+    size_t rank = (size_t)ceil(p * (double)n);
+    return n > 0 ? sorted[rank > 0 ? rank - 1 : 0] : 0;
+}
+
+// "api-bench [requests] [max_concurrency] [latency_ms] [bandwidth_kbps]
+// [error_rate] [slow_rate]": the same requests at 1, 2, 4... in flight,
+// against PLANETS_API_URL when it is set and otherwise against a stand-in
+// server started in this process. The cache is bypassed; the client's
+// timeouts, retries and hedging apply.
+int api_bench_command(int argc, char* argv[]) {
+    static const char* planets[NUM_PLANETS] = {"Mercury", "Venus", "Earth", "Mars",
+                                               "Jupiter", "Saturn", "Uranus", "Neptune"};
+    long requests = argc > 1 ? atol(argv[1]) : 256;
+    long max_concurrency = argc > 2 ? atol(argv[2]) : 32;
+    mock_options_t options = {0, 20, 0, 0, 0, NULL};
+    mock_parse_options(argc, argv, 3, &options);
+    if (requests <= 0 || max_concurrency <= 0 || max_concurrency > MOCK_MAX_CONNECTIONS / 4 ||
+        !mock_options_valid(&options)) {
+        fprintf(stderr, "usage: planets api-bench [requests] [max_concurrency] [latency_ms] [bandwidth_kbps] [error_rate] [slow_rate]\n");
+        return 1;
+    }
+
+    fetch_client_t* client = fetch_client();
+    const char* configured = getenv(FETCH_API_URL_ENV);
+    int local = configured == NULL || configured[0] == 0;
+    mock_server_t server;
+    if (local) {
+        if (mock_start(&server, &options) != 0) {
+            return 1;
+        }
+        mock_url(&server, client->api_url, sizeof(client->api_url));
+        printf("stand-in server: %.0f ms latency, %s, %.0f%% errors, %.0f%% slow\n", options.latency_ms,
+               options.bandwidth > 0 ? "throttled" : "unthrottled", 100 * options.error_rate, 100 * options.slow_rate);
+    }
+
+    size_t n = (size_t)requests;
+    const char** names = malloc(n * sizeof(const char*));
+    planet_t* out = malloc(n * sizeof(planet_t));
+    int* ok = malloc(n * sizeof(int));
+    double* latency = malloc(n * sizeof(double));
+    if (names == NULL || out == NULL || ok == NULL || latency == NULL) {
+        fprintf(stderr, "out of memory\n");
+        free(names);
+        free(out);
+        free(ok);
+        free(latency);
+        if (local) {
+            mock_stop(&server);
+        }
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        names[i] = planets[i % NUM_PLANETS];
+    }
+
+    // The names repeat, every request has to reach the server
+    cache_t* cache = client->cache;
+    client->cache = NULL;
+    int coalesce = client->coalesce;
+    client->coalesce = 0;
+    const fetch_policy_t* policy = &client->policy;
+    printf("%zu requests to %s\n", n, client->api_url);
+    printf("timeouts %ld/%ld ms, %d retries, hedging ", policy->connect_timeout_ms, policy->timeout_ms,
+           policy->retries);
+    if (policy->hedge_ms == 0) {
+        printf("off\n");
+    } else if (policy->hedge_ms < 0) {
+        printf("at the p95\n");
+    } else {
+        printf("after %.0f ms\n", policy->hedge_ms);
+    }
+    printf("%11s %12s %10s %10s %8s %12s %8s %8s %6s\n", "in flight", "requests/s", "p50 ms", "p99 ms", "failed",
+           "connections", "retries", "hedges", "won");
+    int failed = 0;
+    for (long concurrency = 1;; concurrency *= 2) {
+        concurrency = concurrency < max_concurrency ? concurrency : max_concurrency;
+        fetch_stats_t stats;
+        fetch_planet_batch(names, n, (size_t)concurrency, out, ok, latency, &stats);
+        qsort(latency, n, sizeof(double), compare_doubles);
+        printf("%11ld %12.1f %10.2f %10.2f %8zu %12ld %8zu %8zu %6zu\n", concurrency, (double)n / stats.seconds,
+               1000 * percentile(latency, n, 0.5), 1000 * percentile(latency, n, 0.99), stats.failed,
+               stats.connections, stats.retries, stats.hedges, stats.hedges_won);
+        failed |= stats.failed != 0 && options.error_rate == 0;
+        if (concurrency == max_concurrency) {
+            break;
+        }
+    }
+    client->cache = cache;
+    client->coalesce = coalesce;
+
+    if (local) {
+        snprintf(client->api_url, sizeof(client->api_url), "%s", FETCH_API_URL);
+        mock_stop(&server);
+        printf("stand-in server: %zu connections, %zu requests, %zu errors injected, %zu slow\n",
+               server.stats.connections, server.stats.requests, server.stats.errors, server.stats.slow);
+    }
+    free(names);
+    free(out);
+    free(ok);
+    free(latency);
+    return failed;
+}
+
+typedef struct MockJob {
+    pthread_t thread;
+    int rounds;
+    int threaded; // 0 when the job ran inline and there is nothing to join
+    fetch_stats_t stats;
+} mock_job_t;
+
+// One job: the eight planets, round after round, one call at a time
+static void* mock_job_thread(void* arg) {
+    static const char* planets[NUM_PLANETS] = {"Mercury", "Venus", "Earth", "Mars",
+                                               "Jupiter", "Saturn", "Uranus", "Neptune"};
+    mock_job_t* job = arg;
+    for (int r = 0; r < job->rounds; r++) {
+        for (int i = 0; i < NUM_PLANETS; i++) {
+            planet_t planet;
+            fetch_stats_t stats;
+            int ok;
+            fetch_planet_batch(&planets[i], 1, 1, &planet, &ok, NULL, &stats);
+            job->stats.requests += stats.requests;
+            job->stats.failed += stats.failed;
+            job->stats.coalesced += stats.coalesced;
+            job->stats.queued += stats.queued;
+            job->stats.queued_seconds += stats.queued_seconds;
+        }
+    }
+    return NULL;
+}
+
+// "coalesce-bench [jobs] [rounds] [rate_limit] [latency_ms]": jobs threads
+// asking for the same planets at once, each call sent on its own and then
+// through the single-flight layer, under a rate limit of rate_limit
+// requests per second (0 for none). Runs against PLANETS_API_URL when it
+// is set, otherwise against a stand-in server in this process. The cache
+// is bypassed.
+int coalesce_bench_command(int argc, char* argv[]) {
+    static const char* labels[2] = {"direct", "coalesced"};
+    int jobs = argc > 1 ? atoi(argv[1]) : 16;
+    int rounds = argc > 2 ? atoi(argv[2]) : 4;
+    double rate = argc > 3 ? atof(argv[3]) : 0;
+    mock_options_t options = {0, 20, 0, 0, 0, NULL};
+    options.latency_ms = argc > 4 ? atof(argv[4]) : options.latency_ms;
+    if (jobs <= 0 || jobs > MOCK_MAX_CONNECTIONS / 4 || rounds <= 0 || rate < 0 || !mock_options_valid(&options)) {
+        fprintf(stderr, "usage: planets coalesce-bench [jobs] [rounds] [rate_limit] [latency_ms]\n");
+        return 1;
+    }
+    mock_job_t* workers = calloc((size_t)jobs, sizeof(mock_job_t));
+    if (workers == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    fetch_client_t* client = fetch_client();
+    const char* configured = getenv(FETCH_API_URL_ENV);
+    int local = configured == NULL || configured[0] == 0;
+    mock_server_t server;
+    if (local) {
+        if (mock_start(&server, &options) != 0) {
+            free(workers);
+            return 1;
+        }
+        mock_url(&server, client->api_url, sizeof(client->api_url));
+    }
+    cache_t* cache = client->cache;
+    client->cache = NULL;
+    // Only the settings are saved; the bucket itself holds a live mutex
+    pthread_mutex_lock(&client->quota.lock);
+    double saved_rate = client->quota.rate;
+    double saved_burst = client->quota.burst;
+    pthread_mutex_unlock(&client->quota.lock);
+
+    printf("%d jobs x %d rounds x %d planets from %s, ", jobs, rounds, NUM_PLANETS, client->api_url);
+    if (rate > 0) {
+        printf("at most %.0f requests/s\n", rate);
+    } else {
+        printf("no rate limit\n");
+    }
+    printf("%-10s %10s %10s %10s %10s %14s %10s\n", "", "calls", "upstream", "coalesced", "queued",
+           "mean wait ms", "seconds");
+    int failed = 0;
+    int saved_coalesce = client->coalesce;
+    for (int coalesce = 0; coalesce < 2; coalesce++) {
+        client->coalesce = coalesce;
+        fetch_quota_set(client, rate, 1);
+        size_t served = local ? server.stats.requests : 0;
+        double start = bench_now();
+        for (int j = 0; j < jobs; j++) {
+            memset(&workers[j].stats, 0, sizeof(fetch_stats_t));
+            workers[j].rounds = rounds;
+            workers[j].threaded = pthread_create(&workers[j].thread, NULL, mock_job_thread, &workers[j]) == 0;
+            if (!workers[j].threaded) {
+                mock_job_thread(&workers[j]);
+            }
+        }
+        fetch_stats_t total = {0};
+        for (int j = 0; j < jobs; j++) {
+            if (workers[j].threaded) {
+                pthread_join(workers[j].thread, NULL);
+            }
+            total.requests += workers[j].stats.requests;
+            total.failed += workers[j].stats.failed;
+            total.coalesced += workers[j].stats.coalesced;
+            total.queued += workers[j].stats.queued;
+            total.queued_seconds += workers[j].stats.queued_seconds;
+        }
+        double seconds = bench_now() - start;
+        // Requests the server saw, or the calls that weren't coalesced
+        size_t upstream = local ? server.stats.requests - served : total.requests - total.coalesced;
+        printf("%-10s %10zu %10zu %10zu %10zu %14.2f %10.3f\n", labels[coalesce], total.requests, upstream,
+               total.coalesced, total.queued, total.queued > 0 ? 1000 * total.queued_seconds / total.queued : 0,
+               seconds);
+        failed |= total.failed != 0;
+    }
+
+    fetch_quota_set(client, saved_rate, saved_burst);
+    client->coalesce = saved_coalesce;
+    client->cache = cache;
+    if (local) {
+        snprintf(client->api_url, sizeof(client->api_url), "%s", FETCH_API_URL);
+        mock_stop(&server);
+    }
+    free(workers);
+    return failed;
+}
@@ -0,0 +1,74 @@
+#ifndef MOCK_H
+#define MOCK_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Local stand-in for the planets API: answers GET /v1/planets?name=<name>
+// over HTTP/1.1 with keep-alive, one thread per connection, from responses
+// in the API's format. Latency, bandwidth and failures can be dialled in so
+// that the client can be measured without the network. Point the client at
+// it with PLANETS_API_URL=http://127.0.0.1:<port>/v1/planets?name=
+#define MOCK_PATH "/v1/planets"
+#define MOCK_MAX_CONNECTIONS 256
+#define MOCK_REQUEST_SIZE 8192
+#define MOCK_SLOW_FACTOR 10
+
+typedef struct MockOptions {
+    int port;               // 0 picks a free port
+    double latency_ms;      // wait before answering each request
+    double bandwidth;       // body bytes per second per response, 0 for no limit
+    double error_rate;      // fraction of requests that fail, half as a 503 and
+                            // half as a body cut short by closing the connection
+    double slow_rate;       // fraction of requests delayed MOCK_SLOW_FACTOR times
+                            // the latency, a tail for hedging to cut
+    const char *recordings; // directory of <name>.json bodies (lower case), NULL
+                            // for the eight planets built in
+} mock_options_t;
+
+typedef struct MockStats {
+    size_t connections;
+    size_t requests;
+    size_t not_modified; // 304s for a matching If-None-Match
+    size_t errors;       // injected failures
+    size_t slow;         // requests given the slow tail latency
+} mock_stats_t;
+
+typedef struct MockServer {
+    mock_options_t options;
+    int listener;
+    int port;
+    int stopping;
+    pthread_t acceptor;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;       // signalled when the last connection closes
+    int sockets[MOCK_MAX_CONNECTIONS]; // open connections, -1 for free slots
+    size_t active;
+    unsigned seed;
+    mock_stats_t stats;
+} mock_server_t;
+
+// Listen on 127.0.0.1 and serve from a background thread, -1 on failure
+int mock_start(mock_server_t* server, const mock_options_t* options);
+
+// Stop accepting, close every connection and wait for their threads
+void mock_stop(mock_server_t* server);
+
+// The base URL to put in PLANETS_API_URL
+void mock_url(const mock_server_t* server, char* url, size_t size);
+
+// The built-in response body for a lower-case planet name, NULL for none
+const char* mock_recording(const char* name);
+
+// "mock-api [port] [latency_ms] [bandwidth_kbps] [error_rate] [slow_rate]
+// [recordings_dir]" serves until interrupted; "api-bench [requests]
+// [max_concurrency] [latency_ms] [bandwidth_kbps] [error_rate] [slow_rate]"
+// measures fetch+parse against it
+int mock_api_command(int argc, char* argv[]);
+int api_bench_command(int argc, char* argv[]);
+
+// "coalesce-bench [jobs] [rounds] [rate_limit] [latency_ms]": concurrent
+// jobs asking for the same planets, with and without single flight
+int coalesce_bench_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,482 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "mpc.h"
+#include "julian.h"
+#include "pool.h"
+#include "bench.h"
+
+// The header, if any, ends within this many bytes
+#define MPC_HEADER_SCAN 65536
+// Gaussian gravitational constant in degrees: mean daily motion at 1 AU
+#define MPC_GAUSS_DEGREES 0.9856076686
+
+// One line-aligned slice of the file. Its bodies are written from slot
+// base on, base being the number of lines in all earlier chunks, and packed
+// together once every chunk is done.
+typedef struct MpcChunk {
+    const char *begin;
+    const char *end;
+    size_t base;
+    size_t lines;
+    size_t bodies;
+    size_t malformed;
+} mpc_chunk_t;
+
+typedef struct MpcJob {
+    mpc_chunk_t *chunks;
+    elements_t *elements;
+    char (*names)[CATALOG_NAME_SIZE];
+    pthread_mutex_t lock; // guards done and the progress callback
+    size_t done;
+    size_t total;
+    mpc_progress_fn progress;
+    void *user;
+} mpc_job_t;
+
+// Fixed-point decimal such as " 123.45678", with optional sign and
+// surrounding spaces. Up to 15 digits are exact in the mantissa, and one
+// division by an exact power of ten rounds the same way strtod does.
+static int parse_fixed(const char* field, int width, double* out) {
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+                                    1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    int i = 0;
+    while (i < width && field[i] == ' ') {
+        i++;
+    }
+    int negative = i < width && field[i] == '-';
+    i += i < width && (field[i] == '-' || field[i] == '+');
+
+    long long mantissa = 0;
+    int digits = 0, decimals = -1;
+    for (; i < width && field[i] != ' '; i++) {
+        if (field[i] == '.' && decimals < 0) {
+            decimals = 0;
+        } else if (field[i] >= '0' && field[i] <= '9' && digits < 15) {
+            mantissa = mantissa * 10 + (field[i] - '0');
+            digits++;
+            decimals += decimals >= 0;
+        } else {
+            return -1;
+        }
+    }
+    while (i < width && field[i] == ' ') {
+        i++;
+    }
+    if (i < width || digits == 0) {
+        return -1;
+    }
+    double value = (double)mantissa / powers[decimals > 0 ? decimals : 0];
+    *out = negative ? -value : value;
+    return 0;
+}
+
+// 0-9 then A-Z for 10-35, as in packed dates
+static int packed_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 10 : -1;
+}
+
+// Packed epoch such as K24AH (2024-10-17), as a Julian Date at 0h
+static int parse_epoch(const char* field, double* out) {
+    int century = packed_digit(field[0]);
+    int tens = packed_digit(field[1]);
+    int units = packed_digit(field[2]);
+    int month = packed_digit(field[3]);
+    int day = packed_digit(field[4]);
+    if (century < 10 || tens < 0 || tens > 9 || units < 0 || units > 9 ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+        return -1;
+    }
+    *out = julian_date(century * 100 + tens * 10 + units, month, day, 0, 0, 0);
+    return 0;
+}
+
+// Copy field without its surrounding spaces, at most CATALOG_NAME_SIZE - 1 characters
+static void copy_name(char name[CATALOG_NAME_SIZE], const char* field, size_t width) {
+    while (width > 0 && field[0] == ' ') {
+        field++;
+        width--;
+    }
+    while (width > 0 && field[width - 1] == ' ') {
+        width--;
+    }
+    size_t n = width < CATALOG_NAME_SIZE - 1 ? width : CATALOG_NAME_SIZE - 1;
+    memcpy(name, field, n);
+    name[n] = 0;
+}
+
+// Parse one line into slot, -1 when it is malformed
+static int parse_line(const char* line, size_t length, elements_t* elements, size_t slot,
+                      char (*names)[CATALOG_NAME_SIZE]) {
+    double epoch, anomaly, argument, node, inclination, e, motion, a;
+    if (length < MPC_MIN_LINE || parse_epoch(line + 20, &epoch) != 0 ||
+        parse_fixed(line + 26, 9, &anomaly) != 0 || parse_fixed(line + 37, 9, &argument) != 0 ||
+        parse_fixed(line + 48, 9, &node) != 0 || parse_fixed(line + 59, 9, &inclination) != 0 ||
+        parse_fixed(line + 70, 9, &e) != 0 || parse_fixed(line + 80, 11, &motion) != 0 ||
+        parse_fixed(line + 92, 11, &a) != 0) {
+        return -1;
+    }
+    if (e < 0 || e >= 1 || a <= 0 || motion <= 0 || inclination < 0 || inclination > 180) {
+        return -1;
+    }
+
+    // The elements hold the time of perihelion rather than the mean anomaly
+    elements_set(elements, slot, a, e, 360 / motion, epoch - anomaly / motion,
+                 inclination * DEGREES, node * DEGREES, argument * DEGREES);
+    if (names != NULL) {
+        if (length > 166) {
+            copy_name(names[slot], line + 166, length - 166 < 28 ? length - 166 : 28);
+        } else {
+            copy_name(names[slot], line, 7);
+        }
+    }
+    return 0;
+}
+
+static void count_lines(void* context, size_t begin, size_t end, int thread) {
+    (void)thread;
+    mpc_job_t* job = context;
+    for (size_t c = begin; c < end; c++) {
+        mpc_chunk_t* chunk = &job->chunks[c];
+        size_t lines = 0;
+        for (const char* p = chunk->begin; p < chunk->end; lines++) {
+            const char* newline = memchr(p, '\n', chunk->end - p);
+            p = newline != NULL ? newline + 1 : chunk->end;
+        }
+        chunk->lines = lines;
+    }
+}
+
+static void parse_chunks(void* context, size_t begin, size_t end, int thread) {
+    (void)thread;
+    mpc_job_t* job = context;
+    for (size_t c = begin; c < end; c++) {
+        mpc_chunk_t* chunk = &job->chunks[c];
+        for (const char* p = chunk->begin; p < chunk->end; ) {
+            const char* newline = memchr(p, '\n', chunk->end - p);
+            const char* next = newline != NULL ? newline + 1 : chunk->end;
+            size_t length = (newline != NULL ? newline : chunk->end) - p;
+            length -= length > 0 && p[length - 1] == '\r';
+            if (length > 0) {
+                if (parse_line(p, length, job->elements, chunk->base + chunk->bodies, job->names) == 0) {
+                    chunk->bodies++;
+                } else {
+                    chunk->malformed++;
+                }
+            }
+            p = next;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        job->done += chunk->end - chunk->begin;
+        if (job->progress != NULL) {
+            job->progress(job->user, job->done, job->total);
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+// First byte after the header's line of dashes, or data when there is none
+static const char* skip_header(const char* data, size_t size) {
+    size_t scan = size < MPC_HEADER_SCAN ? size : MPC_HEADER_SCAN;
+    for (const char* p = data; p < data + scan; ) {
+        const char* newline = memchr(p, '\n', data + size - p);
+        if (strncmp(p, "-----", data + size - p < 5 ? (size_t)(data + size - p) : 5) == 0) {
+            return newline != NULL ? newline + 1 : data + size;
+        }
+        if (newline == NULL) {
+            break;
+        }
+        p = newline + 1;
+    }
+    return data;
+}
+
+int mpc_load(const char* path, elements_t* elements, char (**names)[CATALOG_NAME_SIZE], int threads,
+             mpc_progress_fn progress, void* user, mpc_stats_t* stats) {
+    double start = bench_now();
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "cannot open %s\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    size_t size = info.st_size;
+    void* map = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "cannot map %s\n", path);
+        return -1;
+    }
+    if (map != NULL) {
+        posix_madvise(map, size, POSIX_MADV_WILLNEED);
+    }
+
+    const char* data = map;
+    const char* end = data + size;
+    const char* body = size > 0 ? skip_header(data, size) : data;
+    size_t chunk_count = (end - body + MPC_CHUNK_BYTES - 1) / MPC_CHUNK_BYTES;
+    mpc_chunk_t* chunks = calloc(chunk_count > 0 ? chunk_count : 1, sizeof(mpc_chunk_t));
+    if (chunks == NULL) {
+        if (map != NULL) {
+            munmap(map, size);
+        }
+        return -1;
+    }
+
+    // Each chunk starts on the line after the byte before its nominal start
+    for (size_t c = 0; c < chunk_count; c++) {
+        const char* nominal = body + c * MPC_CHUNK_BYTES;
+        if (c > 0) {
+            const char* newline = memchr(nominal - 1, '\n', end - nominal + 1);
+            nominal = newline != NULL ? newline + 1 : end;
+        }
+        chunks[c].begin = nominal;
+        if (c > 0) {
+            chunks[c - 1].end = nominal;
+        }
+    }
+    if (chunk_count > 0) {
+        chunks[chunk_count - 1].end = end;
+    }
+
+    // Count lines first so every chunk knows where its slots start
+    mpc_job_t job = {chunks, elements, NULL, PTHREAD_MUTEX_INITIALIZER, 0, end - body, progress, user};
+    int result = pool_run(threads, chunk_count, 1, count_lines, &job, NULL);
+    size_t capacity = 0;
+    for (size_t c = 0; c < chunk_count; c++) {
+        chunks[c].base = capacity;
+        capacity += chunks[c].lines;
+    }
+
+    if (result == 0) {
+        result = elements_init(elements, capacity > 0 ? capacity : 1);
+    }
+    if (result == 0 && names != NULL) {
+        job.names = calloc(capacity > 0 ? capacity : 1, CATALOG_NAME_SIZE);
+        if (job.names == NULL) {
+            elements_free(elements);
+            result = -1;
+        }
+    }
+    if (result == 0) {
+        result = pool_run(threads, chunk_count, 1, parse_chunks, &job, NULL);
+        if (result != 0) {
+            elements_free(elements);
+            free(job.names);
+        }
+    }
+
+    if (result == 0) {
+        // Close the gaps left by malformed and blank lines
+        double* arrays[ELEMENTS_FIELDS];
+        elements_arrays(elements, arrays);
+        size_t count = 0, lines = 0, malformed = 0;
+        for (size_t c = 0; c < chunk_count; c++) {
+            if (chunks[c].base != count) {
+                for (int f = 0; f < ELEMENTS_FIELDS; f++) {
+                    memmove(arrays[f] + count, arrays[f] + chunks[c].base, chunks[c].bodies * sizeof(double));
+                }
+                if (job.names != NULL) {
+                    memmove(job.names[count], job.names[chunks[c].base], chunks[c].bodies * CATALOG_NAME_SIZE);
+                }
+            }
+            count += chunks[c].bodies;
+            lines += chunks[c].bodies + chunks[c].malformed;
+            malformed += chunks[c].malformed;
+        }
+        elements->count = count;
+        // Only handed out once the parse has succeeded
+        if (names != NULL) {
+            *names = job.names;
+        }
+
+        if (stats != NULL) {
+            stats->lines = lines;
+            stats->bodies = count;
+            stats->malformed = malformed;
+            stats->seconds = bench_now() - start;
+        }
+    }
+
+    pthread_mutex_destroy(&job.lock);
+    free(chunks);
+    if (map != NULL) {
+        munmap(map, size);
+    }
+    return result;
+}
+
+static void print_progress(void* user, size_t done, size_t total) {
+    (void)user;
+    fprintf(stderr, "\rparsed %3.0f%%", total > 0 ? 100.0 * done / total : 100.0);
+}
+
+// "mpc-load file [threads] [catalog_file]": load an MPCORB file, propagate
+// every body to the current time, and optionally save it as a catalog
+// snapshot for sweep and approach
+int mpc_load_command(int argc, char* argv[]) {
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    if (argc < 2 || threads < 0) {
+        fprintf(stderr, "usage: planets mpc-load file [threads] [catalog_file]\n");
+        return 1;
+    }
+    if (threads == 0) {
+        threads = pool_default_threads();
+    }
+
+    elements_t elements;
+    char (*names)[CATALOG_NAME_SIZE] = NULL;
+    mpc_stats_t stats;
+    int interactive = isatty(STDERR_FILENO);
+    if (mpc_load(argv[1], &elements, argc > 3 ? &names : NULL, threads,
+                 interactive ? print_progress : NULL, NULL, &stats) != 0) {
+        return 1;
+    }
+    if (interactive) {
+        fprintf(stderr, "\n");
+    }
+    printf("%zu bodies from %zu lines (%zu malformed, skipped) in %.1f ms on %d threads\n",
+           stats.bodies, stats.lines, stats.malformed, stats.seconds * 1e3, threads);
+
+    // The loaded elements go straight to the propagator
+    size_t n = elements.count;
+    coordinates_t* positions = malloc((n ? n : 1) * sizeof(coordinates_t));
+    if (positions == NULL) {
+        fprintf(stderr, "not enough memory for %zu positions\n", n);
+        free(names);
+        elements_free(&elements);
+        return 1;
+    }
+    double start = bench_now();
+    propagate_all_day(&elements, n, julian_from_unix(time(NULL)), positions);
+    double seconds = bench_now() - start;
+    double distance = 0;
+    for (size_t i = 0; i < n; i++) {
+        distance += sqrt(positions[i].x * positions[i].x + positions[i].y * positions[i].y +
+                         positions[i].z * positions[i].z);
+    }
+    printf("propagated to now in %.1f ms, mean heliocentric distance %.3f AU\n", seconds * 1e3,
+           n > 0 ? distance / n : 0);
+    free(positions);
+
+    int result = 0;
+    if (argc > 3) {
+        result = catalog_write(argv[3], &elements, (const char (*)[CATALOG_NAME_SIZE])names);
+        if (result == 0) {
+            printf("wrote %s\n", argv[3]);
+        }
+    }
+    free(names);
+    elements_free(&elements);
+    return result == 0 ? 0 : 1;
+}
+
+// Reproducible MPCORB-style file: a header, lines bodies with the same
+// distribution as elements_add_synthetic, and every 1000th line cut short
+static int write_synthetic_mpc(const char* path, size_t lines) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return -1;
+    }
+    fputs("MINOR PLANET CENTER ORBIT DATABASE (MPCORB)\n\nsynthetic, for mpc-bench\n\n", file);
+    fputs("Des'n     H     G   Epoch     M        Peri.      Node       Incl.       e            n           a\n", file);
+    fputs("----------------------------------------------------------------------------------------------------\n", file);
+
+    srand(1306);
+    char line[256];
+    for (size_t i = 0; i < lines; i++) {
+        double a = 0.4 + 40.0 * rand() / RAND_MAX;
+        double e = 0.3 * rand() / RAND_MAX;
+        double anomaly = 360.0 * rand() / RAND_MAX;
+        double inclination = 20.0 * rand() / RAND_MAX;
+        double node = 360.0 * rand() / RAND_MAX;
+        double argument = 360.0 * rand() / RAND_MAX;
+        char readable[32];
+        snprintf(readable, sizeof(readable), "(%zu)", i + 1);
+        int length = snprintf(line, sizeof(line),
+                              "%07zu %5.2f %5.2f K24AH %9.5f  %9.5f  %9.5f  %9.5f  %9.7f %11.8f %11.7f  0 MPO000000 "
+                              "%5d %3d 2000-2024 0.50 M-v 3Ek MPCLINUX   0000 %-28s 20240101\n",
+                              (i + 1) % 10000000, 15.0, 0.15, anomaly, argument, node, inclination, e,
+                              MPC_GAUSS_DEGREES / (a * sqrt(a)), a, 100, 10, readable);
+        if (i % 1000 == 999) {
+            length = 60;
+            line[length - 1] = '\n';
+        }
+        fwrite(line, 1, length, file);
+    }
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "error writing %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// "mpc-bench [lines] [threads] [file]": write a synthetic MPCORB file and
+// load it on one thread and on threads threads (default one per core)
+int mpc_bench_command(int argc, char* argv[]) {
+    size_t lines = argc > 1 ? strtoul(argv[1], NULL, 10) : 1300000;
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    const char* path = argc > 3 ? argv[3] : "mpc-bench.dat";
+    if (lines == 0 || threads < 0) {
+        fprintf(stderr, "usage: planets mpc-bench [lines] [threads] [file]\n");
+        return 1;
+    }
+    if (threads == 0) {
+        threads = pool_default_threads();
+    }
+    if (write_synthetic_mpc(path, lines) != 0) {
+        return 1;
+    }
+
+    elements_t serial, parallel;
+    mpc_stats_t serial_stats, parallel_stats;
+    if (mpc_load(path, &serial, NULL, 1, NULL, NULL, &serial_stats) != 0) {
+        return 1;
+    }
+    if (mpc_load(path, &parallel, NULL, threads, NULL, NULL, &parallel_stats) != 0) {
+        elements_free(&serial);
+        return 1;
+    }
+
+    struct stat info;
+    double megabytes = stat(path, &info) == 0 ? info.st_size / 1048576.0 : 0;
+    printf("%s: %.1f MB, %zu bodies, %zu malformed lines skipped\n\n", path, megabytes,
+           parallel_stats.bodies, parallel_stats.malformed);
+    bench_report("mpc_load 1 thread", (double)serial_stats.lines, "lines", serial_stats.seconds);
+    char label[64];
+    snprintf(label, sizeof(label), "mpc_load %d threads", threads);
+    bench_report(label, (double)parallel_stats.lines, "lines", parallel_stats.seconds);
+
+    // Chunking must not change what is loaded
+    int same = serial.count == parallel.count;
+    double* a[ELEMENTS_FIELDS];
+    double* b[ELEMENTS_FIELDS];
+    elements_arrays(&serial, a);
+    elements_arrays(&parallel, b);
+    for (int f = 0; f < ELEMENTS_FIELDS && same; f++) {
+        same = memcmp(a[f], b[f], serial.count * sizeof(double)) == 0;
+    }
+    printf("\nspeedup %.1fx, %s\n", serial_stats.seconds / parallel_stats.seconds,
+           same ? "identical elements" : "ELEMENTS DIFFER");
+
+    elements_free(&serial);
+    elements_free(&parallel);
+    return same ? 0 : 1;
+}
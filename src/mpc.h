@@ -0,0 +1,40 @@
+#ifndef MPC_H
+#define MPC_H
+
+#include <stddef.h>
+#include "propagate.h"
+#include "catalog.h"
+
+// Minor Planet Center MPCORB.DAT: one body per fixed-width line. Columns
+// used, 1-based: designation 1-7, packed epoch 21-25, mean anomaly 27-35,
+// argument of perihelion 38-46, ascending node 49-57, inclination 60-68
+// (degrees, J2000 ecliptic), eccentricity 71-79, mean daily motion 81-91
+// (degrees per day), semi-major axis 93-103 (AU), readable designation
+// 167-194. Anything before a line of dashes is a header.
+#define MPC_MIN_LINE 103
+#define MPC_CHUNK_BYTES (1 << 20) // lines are parsed in line-aligned chunks of about this size
+
+typedef struct MpcStats {
+    size_t lines;     // non-blank lines after the header
+    size_t bodies;
+    size_t malformed; // lines skipped: too short, bad number or impossible orbit
+    double seconds;
+} mpc_stats_t;
+
+// Called after every chunk, from whichever thread parsed it, never
+// concurrently, with the bytes parsed so far
+typedef void (*mpc_progress_fn)(void* user, size_t done, size_t total);
+
+// Map an MPCORB file and parse it on threads threads (0 for one per core)
+// into elements, which is initialized here. names, when not NULL, gets a
+// malloc'd array of readable designations, and is left alone on failure.
+// Malformed lines are counted and skipped; only an unreadable file or
+// running out of memory fails.
+int mpc_load(const char* path, elements_t* elements, char (**names)[CATALOG_NAME_SIZE], int threads,
+             mpc_progress_fn progress, void* user, mpc_stats_t* stats);
+
+// "mpc-load file [threads] [catalog_file]" and "mpc-bench [lines] [threads] [file]" modes
+int mpc_load_command(int argc, char* argv[]);
+int mpc_bench_command(int argc, char* argv[]);
+
+#endif
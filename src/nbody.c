@@ -0,0 +1,441 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include "nbody.h"
+#include "kepler.h"
+#include "pool.h"
+#include "bench.h"
+
+// Fewest test particles worth a thread of their own
+#define NBODY_CHUNK 4096
+
+int nbody_init(nbody_t* system, size_t capacity) {
+    system->count = 0;
+    system->massive = 0;
+    system->capacity = capacity;
+    system->day = 0;
+    system->x = malloc(capacity * sizeof(double));
+    system->y = malloc(capacity * sizeof(double));
+    system->z = malloc(capacity * sizeof(double));
+    system->vx = malloc(capacity * sizeof(double));
+    system->vy = malloc(capacity * sizeof(double));
+    system->vz = malloc(capacity * sizeof(double));
+    system->ax = malloc(capacity * sizeof(double));
+    system->ay = malloc(capacity * sizeof(double));
+    system->az = malloc(capacity * sizeof(double));
+    system->gm = malloc(capacity * sizeof(double));
+
+    if (!system->x || !system->y || !system->z || !system->vx || !system->vy || !system->vz ||
+        !system->ax || !system->ay || !system->az || !system->gm) {
+        fprintf(stderr, "not enough memory for %zu bodies\n", capacity);
+        nbody_free(system);
+        return -1;
+    }
+    return 0;
+}
+
+void nbody_free(nbody_t* system) {
+    free(system->x);
+    free(system->y);
+    free(system->z);
+    free(system->vx);
+    free(system->vy);
+    free(system->vz);
+    free(system->ax);
+    free(system->ay);
+    free(system->az);
+    free(system->gm);
+    system->x = system->y = system->z = NULL;
+    system->vx = system->vy = system->vz = NULL;
+    system->ax = system->ay = system->az = NULL;
+    system->gm = NULL;
+    system->count = 0;
+    system->capacity = 0;
+}
+
+double nbody_planet_gm(const planet_t* planet) {
+    // planet_from_json stores the API mass (in Jupiter masses) times 100
+    return NBODY_GM_SUN * NBODY_JUPITER_MASS * planet->mass / 100;
+}
+
+// Add the pull of one body of gm at (xj, yj, zj) to bodies [begin, end).
+// The arrays have to be restrict parameters: GCC ignores restrict on local
+// pointers and would otherwise keep the loop scalar for fear of aliasing.
+static void nbody_pull(const double* restrict x, const double* restrict y, const double* restrict z,
+                       double* restrict ax, double* restrict ay, double* restrict az,
+                       size_t begin, size_t end, double xj, double yj, double zj, double gm) {
+    for (size_t i = begin; i < end; i++) {
+        double dx = xj - x[i];
+        double dy = yj - y[i];
+        double dz = zj - z[i];
+        double r2 = dx * dx + dy * dy + dz * dz;
+        double scale = gm / (r2 * sqrt(r2));
+        ax[i] += dx * scale;
+        ay[i] += dy * scale;
+        az[i] += dz * scale;
+    }
+}
+
+// Forces between the Sun and the massive bodies, O(massive^2). Every pair
+// is worked out from both ends rather than once with Newton's third law, so
+// each source runs the same vectorized loop as the particles, split around
+// itself.
+static void massive_accelerations(nbody_t* system) {
+    size_t m = system->massive;
+    for (size_t i = 0; i < m; i++) {
+        system->ax[i] = 0;
+        system->ay[i] = 0;
+        system->az[i] = 0;
+    }
+    for (size_t j = 0; j < m; j++) {
+        double xj = system->x[j], yj = system->y[j], zj = system->z[j], gm = system->gm[j];
+        nbody_pull(system->x, system->y, system->z, system->ax, system->ay, system->az, 0, j, xj, yj, zj, gm);
+        nbody_pull(system->x, system->y, system->z, system->ax, system->ay, system->az, j + 1, m, xj, yj, zj, gm);
+    }
+}
+
+// Forces of every massive body on test particles [begin, end)
+static void particle_accelerations(nbody_t* system, size_t begin, size_t end) {
+    size_t m = system->massive;
+    begin += m;
+    end += m;
+    for (size_t i = begin; i < end; i++) {
+        system->ax[i] = 0;
+        system->ay[i] = 0;
+        system->az[i] = 0;
+    }
+    for (size_t j = 0; j < m; j++) {
+        nbody_pull(system->x, system->y, system->z, system->ax, system->ay, system->az, begin, end,
+                   system->x[j], system->y[j], system->z[j], system->gm[j]);
+    }
+}
+
+static void nbody_accelerations(nbody_t* system) {
+    massive_accelerations(system);
+    particle_accelerations(system, 0, system->count - system->massive);
+}
+
+int nbody_from_elements(nbody_t* system, const elements_t* elements, const double* gm,
+                        size_t massive, double day) {
+    size_t n = elements->count;
+    if (n == 0 || n + 1 > system->capacity || massive > n) {
+        return -1;
+    }
+
+    double* M = malloc(n * sizeof(double));
+    double* E = malloc(n * sizeof(double));
+    double* sinE = malloc(n * sizeof(double));
+    double* cosE = malloc(n * sizeof(double));
+    if (!M || !E || !sinE || !cosE) {
+        free(M); free(E); free(sinE); free(cosE);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        M[i] = elements->mean_motion[i] * (day - elements->perihelion_day[i]);
+    }
+    kepler_solve(M, elements->eccentricity, E, sinE, cosE, n);
+
+    // Sun at the origin, then every body's heliocentric Keplerian state
+    system->x[0] = system->y[0] = system->z[0] = 0;
+    system->vx[0] = system->vy[0] = system->vz[0] = 0;
+    system->gm[0] = NBODY_GM_SUN;
+    for (size_t i = 0; i < n; i++) {
+        double a = elements->semi_major_axis[i];
+        double e = elements->eccentricity[i];
+        double body_gm = i < massive ? gm[i] : 0;
+        // Mean motion from Kepler's third law so the orbit closes under the
+        // same gravity the integrator uses
+        double motion = sqrt((NBODY_GM_SUN + body_gm) / (a * a * a));
+        double rate = motion / (1 - e * cosE[i]); // dE/dt
+
+        // In the orbital plane, then along P and Q
+        double along = a * (cosE[i] - e);
+        double across = elements->semi_minor_axis[i] * sinE[i];
+        double along_rate = -a * sinE[i] * rate;
+        double across_rate = elements->semi_minor_axis[i] * cosE[i] * rate;
+        system->x[i + 1] = along * elements->px[i] + across * elements->qx[i];
+        system->y[i + 1] = along * elements->py[i] + across * elements->qy[i];
+        system->z[i + 1] = along * elements->pz[i] + across * elements->qz[i];
+        system->vx[i + 1] = along_rate * elements->px[i] + across_rate * elements->qx[i];
+        system->vy[i + 1] = along_rate * elements->py[i] + across_rate * elements->qy[i];
+        system->vz[i + 1] = along_rate * elements->pz[i] + across_rate * elements->qz[i];
+        system->gm[i + 1] = body_gm;
+    }
+    free(M);
+    free(E);
+    free(sinE);
+    free(cosE);
+
+    system->count = n + 1;
+    system->massive = massive + 1;
+    system->day = day;
+
+    // Move to the barycentric frame, test particles keep their state
+    // relative to the Sun
+    double total = 0, cx = 0, cy = 0, cz = 0, cvx = 0, cvy = 0, cvz = 0;
+    for (size_t i = 0; i < system->massive; i++) {
+        total += system->gm[i];
+        cx += system->gm[i] * system->x[i];
+        cy += system->gm[i] * system->y[i];
+        cz += system->gm[i] * system->z[i];
+        cvx += system->gm[i] * system->vx[i];
+        cvy += system->gm[i] * system->vy[i];
+        cvz += system->gm[i] * system->vz[i];
+    }
+    for (size_t i = 0; i < system->count; i++) {
+        system->x[i] -= cx / total;
+        system->y[i] -= cy / total;
+        system->z[i] -= cz / total;
+        system->vx[i] -= cvx / total;
+        system->vy[i] -= cvy / total;
+        system->vz[i] -= cvz / total;
+    }
+
+    nbody_accelerations(system);
+    return 0;
+}
+
+// Half kick, then drift, of bodies [begin, end)
+static void nbody_kick_drift(double* restrict x, double* restrict y, double* restrict z,
+                             double* restrict vx, double* restrict vy, double* restrict vz,
+                             const double* restrict ax, const double* restrict ay, const double* restrict az,
+                             size_t begin, size_t end, double h) {
+    for (size_t i = begin; i < end; i++) {
+        vx[i] += 0.5 * h * ax[i];
+        vy[i] += 0.5 * h * ay[i];
+        vz[i] += 0.5 * h * az[i];
+        x[i] += h * vx[i];
+        y[i] += h * vy[i];
+        z[i] += h * vz[i];
+    }
+}
+
+static void nbody_kick(double* restrict vx, double* restrict vy, double* restrict vz,
+                       const double* restrict ax, const double* restrict ay, const double* restrict az,
+                       size_t begin, size_t end, double h) {
+    for (size_t i = begin; i < end; i++) {
+        vx[i] += 0.5 * h * ax[i];
+        vy[i] += 0.5 * h * ay[i];
+        vz[i] += 0.5 * h * az[i];
+    }
+}
+
+// One kick-drift-kick step of h days for bodies [begin, end); the
+// accelerations are left to the caller
+static void nbody_first_half(nbody_t* s, size_t begin, size_t end, double h) {
+    nbody_kick_drift(s->x, s->y, s->z, s->vx, s->vy, s->vz, s->ax, s->ay, s->az, begin, end, h);
+}
+
+static void nbody_second_half(nbody_t* s, size_t begin, size_t end, double h) {
+    nbody_kick(s->vx, s->vy, s->vz, s->ax, s->ay, s->az, begin, end, h);
+}
+
+// Threads that integrate one system together for a whole nbody_advance.
+// Each owns a slice of the test particles, and the first also moves the
+// massive bodies. Two barriers per step: one once every position has
+// drifted, before any force is read from them, and one once every force has
+// been used, before the massive bodies move again.
+typedef struct NBodyTeam {
+    nbody_t *system;
+    long steps;
+    double h;
+    pthread_barrier_t barrier;
+    pthread_mutex_t lock;
+    pthread_cond_t started;
+    int go; // 0 while the threads start, 1 to run, -1 when one failed to start
+} nbody_team_t;
+
+typedef struct NBodyWorker {
+    nbody_team_t *team;
+    pthread_t thread;
+    size_t begin; // test particles [begin, end)
+    size_t end;
+    int first;
+} nbody_worker_t;
+
+static void* nbody_worker(void* arg) {
+    nbody_worker_t* worker = arg;
+    nbody_team_t* team = worker->team;
+    nbody_t* system = team->system;
+    pthread_mutex_lock(&team->lock);
+    while (team->go == 0) {
+        pthread_cond_wait(&team->started, &team->lock);
+    }
+    int go = team->go;
+    pthread_mutex_unlock(&team->lock);
+    if (go < 0) {
+        return NULL;
+    }
+
+    size_t m = system->massive;
+    size_t from = worker->first ? 0 : m + worker->begin;
+    size_t to = m + worker->end;
+    for (long k = 0; k < team->steps; k++) {
+        nbody_first_half(system, from, to, team->h);
+        pthread_barrier_wait(&team->barrier);
+        if (worker->first) {
+            massive_accelerations(system);
+        }
+        particle_accelerations(system, worker->begin, worker->end);
+        nbody_second_half(system, from, to, team->h);
+        pthread_barrier_wait(&team->barrier);
+    }
+    return NULL;
+}
+
+// steps steps of h days on threads threads, -1 when they could not all be
+// started, in which case nothing has moved
+static int nbody_advance_team(nbody_t* system, long steps, double h, int threads) {
+    nbody_worker_t* workers = calloc((size_t)threads, sizeof(nbody_worker_t));
+    if (workers == NULL) {
+        return -1;
+    }
+    nbody_team_t team;
+    team.system = system;
+    team.steps = steps;
+    team.h = h;
+    team.go = 0;
+    pthread_mutex_init(&team.lock, NULL);
+    pthread_cond_init(&team.started, NULL);
+    size_t particles = system->count - system->massive;
+    int created = 1;
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (nbody_worker_t){&team, 0, particles * t / threads, particles * (t + 1) / threads, t == 0};
+    }
+    while (created < threads &&
+           pthread_create(&workers[created].thread, NULL, nbody_worker, &workers[created]) == 0) {
+        created++;
+    }
+
+    // The barrier only exists once every thread that will wait on it does
+    int ok = created == threads && pthread_barrier_init(&team.barrier, NULL, (unsigned)threads) == 0;
+    pthread_mutex_lock(&team.lock);
+    team.go = ok ? 1 : -1;
+    pthread_cond_broadcast(&team.started);
+    pthread_mutex_unlock(&team.lock);
+    if (ok) {
+        nbody_worker(&workers[0]);
+    }
+    for (int t = 1; t < created; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+
+    if (ok) {
+        pthread_barrier_destroy(&team.barrier);
+    }
+    pthread_cond_destroy(&team.started);
+    pthread_mutex_destroy(&team.lock);
+    free(workers);
+    return ok ? 0 : -1;
+}
+
+void nbody_advance(nbody_t* system, double target_day, double step, int threads) {
+    double span = target_day - system->day;
+    long steps = (long)ceil(fabs(span) / step);
+    if (steps == 0) {
+        return;
+    }
+    double h = span / steps;
+    size_t particles = system->count - system->massive;
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+    if ((size_t)threads > particles / NBODY_CHUNK) {
+        threads = (int)(particles / NBODY_CHUNK);
+    }
+    if (threads < 2 || nbody_advance_team(system, steps, h, threads) != 0) {
+        for (long k = 0; k < steps; k++) {
+            nbody_first_half(system, 0, system->count, h);
+            nbody_accelerations(system);
+            nbody_second_half(system, 0, system->count, h);
+        }
+    }
+    system->day = target_day;
+}
+
+void nbody_heliocentric(const nbody_t* system, coordinates_t* out) {
+    for (size_t i = 1; i < system->count; i++) {
+        out[i - 1].x = system->x[i] - system->x[0];
+        out[i - 1].y = system->y[i] - system->y[0];
+        out[i - 1].z = system->z[i] - system->z[0];
+    }
+}
+
+// Energy of the massive bodies divided by G
+double nbody_energy(const nbody_t* system) {
+    double energy = 0;
+    for (size_t i = 0; i < system->massive; i++) {
+        double v2 = system->vx[i] * system->vx[i] + system->vy[i] * system->vy[i] +
+                    system->vz[i] * system->vz[i];
+        energy += 0.5 * system->gm[i] * v2;
+        for (size_t j = i + 1; j < system->massive; j++) {
+            double dx = system->x[j] - system->x[i];
+            double dy = system->y[j] - system->y[i];
+            double dz = system->z[j] - system->z[i];
+            energy -= system->gm[i] * system->gm[j] / sqrt(dx * dx + dy * dy + dz * dz);
+        }
+    }
+    return energy;
+}
+
+// "nbody-bench [particles] [years] [threads]": the eight planets from the
+// built-in table plus synthetic test particles
+int nbody_bench_command(int argc, char* argv[]) {
+    size_t particles = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    double years = argc > 2 ? atof(argv[2]) : 1;
+    int threads = argc > 3 ? atoi(argv[3]) : 0;
+    if (years <= 0) {
+        fprintf(stderr, "usage: planets nbody-bench [particles] [years] [threads]\n");
+        return 1;
+    }
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+
+    planet_t planet_data[NUM_PLANETS];
+    planet_t* planets[NUM_PLANETS];
+    double gm[NUM_PLANETS];
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i] = &planet_data[i];
+    }
+    load_planet_table(planets);
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        gm[i] = nbody_planet_gm(planets[i]);
+    }
+
+    elements_t elements;
+    if (elements_init(&elements, NUM_PLANETS + particles) != 0) {
+        return 1;
+    }
+    if (elements_from_planets(&elements, planets, NUM_PLANETS) != 0 ||
+        elements_add_synthetic(&elements, particles) != 0) {
+        elements_free(&elements);
+        return 1;
+    }
+
+    nbody_t system;
+    if (nbody_init(&system, elements.count + 1) != 0 ||
+        nbody_from_elements(&system, &elements, gm, NUM_PLANETS, NBODY_EPOCH_DAY) != 0) {
+        elements_free(&elements);
+        return 1;
+    }
+
+    double energy = nbody_energy(&system);
+    double span = 365.25 * years;
+    double start = bench_now();
+    nbody_advance(&system, NBODY_EPOCH_DAY + span, NBODY_DEFAULT_STEP, threads);
+    double elapsed = bench_now() - start;
+    double steps = ceil(span / NBODY_DEFAULT_STEP);
+
+    printf("%d planets + %zu test particles, %.1f years in %.1f-day steps on %d threads\n",
+           NUM_PLANETS, particles, years, NBODY_DEFAULT_STEP, threads);
+    bench_report("leapfrog steps", steps, "steps", elapsed);
+    bench_report("particle-steps", steps * (NUM_PLANETS + particles), "particle-steps", elapsed);
+    printf("relative energy error %.3e\n", fabs((nbody_energy(&system) - energy) / energy));
+
+    nbody_free(&system);
+    elements_free(&elements);
+    return 0;
+}
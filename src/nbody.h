@@ -0,0 +1,56 @@
+#ifndef NBODY_H
+#define NBODY_H
+
+#include <stddef.h>
+#include "planets.h"
+#include "propagate.h"
+
+// Gaussian gravitational constant squared: GM of the Sun in AU^3/day^2
+#define NBODY_GM_SUN 2.959122082855911e-4
+// Jupiter mass in solar masses, the API reports planet masses in Jupiters
+#define NBODY_JUPITER_MASS 9.547919e-4
+// Default leapfrog step in days, about 1/180 of Mercury's orbit
+#define NBODY_DEFAULT_STEP 0.5
+// Epoch the integration starts from, positions before it are integrated backwards
+#define NBODY_EPOCH_DAY 2460676.5 // Julian Date of 1/1/2025 00:00
+
+// Leapfrog (kick-drift-kick) integrator in barycentric ecliptic coordinates. Body 0 is the Sun, then the
+// massive bodies, then massless test particles that only feel the massive
+// ones. Per-field arrays so the test particle loop vectorizes.
+typedef struct NBody {
+    size_t count;
+    size_t massive;  // Sun included
+    size_t capacity;
+    double day;
+    double *x, *y, *z;
+    double *vx, *vy, *vz;
+    double *ax, *ay, *az;
+    double *gm;      // AU^3/day^2, 0 for test particles
+} nbody_t;
+
+int nbody_init(nbody_t* system, size_t capacity);
+void nbody_free(nbody_t* system);
+
+// Set up the Sun, the massive bodies (elements[0, massive), with their GM) and
+// the test particles (elements[massive, count)) from their Keplerian state on day
+int nbody_from_elements(nbody_t* system, const elements_t* elements, const double* gm,
+                        size_t massive, double day);
+
+// GM of a planet loaded by load_planets
+double nbody_planet_gm(const planet_t* planet);
+
+// Integrate to target_day in steps of at most step days. The test particles
+// are split over threads (0 = all cores, fewer for a small system) that are
+// started once and kept for every step.
+void nbody_advance(nbody_t* system, double target_day, double step, int threads);
+
+// Positions relative to the Sun of bodies 1..count-1, for the renderer
+void nbody_heliocentric(const nbody_t* system, coordinates_t* out);
+
+// Total energy, to check the integrator stays symplectic
+double nbody_energy(const nbody_t* system);
+
+// "nbody-bench" mode: steps/second and energy drift with test particles
+int nbody_bench_command(int argc, char* argv[]);
+
+#endif
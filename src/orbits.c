@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "orbits.h"
+#include "kepler.h"
+#include "bench.h"
+
+// Full precision 2 PI for rebasing mean anomalies, PI is only good to 1e-10
+#define ORBITS_2PI 6.28318530717958647693
+
+// Same targets as the Kepler kernels; 16-byte vectors are also the
+// baseline elsewhere (NEON), where the same code is built untargeted. The
+// baseline includes also define init/free and the conversion.
+#define ORBITS_SUFFIX sse2
+#define ORBITS_TARGET
+#define ORBITS_VECTOR_BYTES 16
+#define ORBITS_STORAGE 1
+#define ORBITS_DOUBLE 0
+#include "orbits_kernel.h"
+#undef ORBITS_DOUBLE
+#define ORBITS_DOUBLE 1
+#include "orbits_kernel.h"
+#undef ORBITS_DOUBLE
+#undef ORBITS_STORAGE
+#undef ORBITS_SUFFIX
+#undef ORBITS_TARGET
+#undef ORBITS_VECTOR_BYTES
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ORBITS_HAVE_X86 1
+
+#define ORBITS_SUFFIX avx2
+#define ORBITS_TARGET __attribute__((target("avx2,fma")))
+#define ORBITS_VECTOR_BYTES 32
+#define ORBITS_DOUBLE 0
+#include "orbits_kernel.h"
+#undef ORBITS_DOUBLE
+#define ORBITS_DOUBLE 1
+#include "orbits_kernel.h"
+#undef ORBITS_DOUBLE
+#undef ORBITS_SUFFIX
+#undef ORBITS_TARGET
+#undef ORBITS_VECTOR_BYTES
+
+#define ORBITS_SUFFIX avx512
+#define ORBITS_TARGET __attribute__((target("avx512f,avx512dq")))
+#define ORBITS_VECTOR_BYTES 64
+#define ORBITS_DOUBLE 0
+#include "orbits_kernel.h"
+#undef ORBITS_DOUBLE
+#define ORBITS_DOUBLE 1
+#include "orbits_kernel.h"
+#undef ORBITS_DOUBLE
+#undef ORBITS_SUFFIX
+#undef ORBITS_TARGET
+#undef ORBITS_VECTOR_BYTES
+#endif
+
+typedef struct OrbitsKernel {
+    const char* name;
+    void (*propagate_float)(const orbits_float_t* orbits, double day, float* x, float* y, float* z);
+    void (*propagate_double)(const orbits_double_t* orbits, double day, double* x, double* y, double* z);
+} orbits_kernel_t;
+
+static const orbits_kernel_t kernels[] = {
+#ifdef ORBITS_HAVE_X86
+    {"avx512", orbits_propagate_float_avx512, orbits_propagate_double_avx512},
+    {"avx2", orbits_propagate_float_avx2, orbits_propagate_double_avx2},
+    {"sse2", orbits_propagate_float_sse2, orbits_propagate_double_sse2},
+#else
+    {"generic", orbits_propagate_float_sse2, orbits_propagate_double_sse2},
+#endif
+};
+
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+// The kernels for the instruction set kepler_solve runs on, so CPU
+// detection, PLANETS_KEPLER and kepler_use apply here too. The scalar and
+// table solvers fall back to the baseline kernels.
+static const orbits_kernel_t* orbits_kernel(void) {
+    const char* solver = kepler_solver_name();
+    for (size_t i = 0; i < NUM_KERNELS; i++) {
+        if (strcmp(kernels[i].name, solver) == 0) {
+            return &kernels[i];
+        }
+    }
+    return &kernels[NUM_KERNELS - 1];
+}
+
+void orbits_propagate_float(const orbits_float_t* orbits, double day, float* x, float* y, float* z) {
+    orbits_kernel()->propagate_float(orbits, day, x, y, z);
+}
+
+void orbits_propagate_double(const orbits_double_t* orbits, double day, double* x, double* y, double* z) {
+    orbits_kernel()->propagate_double(orbits, day, x, y, z);
+}
+
+const char* orbits_kernel_name(void) {
+    return orbits_kernel()->name;
+}
+
+#define ORBITS_BENCH_EPOCH 2460000.0
+
+// "precision-bench [bodies] [dates]": the float and double instantiations
+// against propagate_all_day on a synthetic catalog, with their errors
+int orbits_bench_command(int argc, char* argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    int dates = argc > 2 ? atoi(argv[2]) : 10;
+    if (n == 0 || dates <= 0) {
+        fprintf(stderr, "usage: planets precision-bench [bodies] [dates]\n");
+        return 1;
+    }
+
+    elements_t elements;
+    if (elements_synthetic(&elements, n) != 0) {
+        return 1;
+    }
+    orbits_float_t single;
+    orbits_double_t full;
+    if (orbits_init_float(&single, n) != 0) {
+        elements_free(&elements);
+        return 1;
+    }
+    if (orbits_init_double(&full, n) != 0) {
+        orbits_free_float(&single);
+        elements_free(&elements);
+        return 1;
+    }
+    orbits_from_elements_float(&single, &elements, ORBITS_BENCH_EPOCH);
+    orbits_from_elements_double(&full, &elements, ORBITS_BENCH_EPOCH);
+
+    coordinates_t* reference = malloc(n * sizeof(coordinates_t));
+    double* out = malloc(3 * n * sizeof(double));
+    float* out_float = malloc(3 * n * sizeof(float));
+    if (reference == NULL || out == NULL || out_float == NULL) {
+        fprintf(stderr, "not enough memory for %zu positions\n", n);
+        free(reference);
+        free(out);
+        free(out_float);
+        orbits_free_double(&full);
+        orbits_free_float(&single);
+        elements_free(&elements);
+        return 1;
+    }
+
+    printf("%zu bodies, %d dates from the epoch, %s kernels\n\n", n, dates, orbits_kernel_name());
+
+    double start = bench_now();
+    for (int d = 0; d < dates; d++) {
+        propagate_all_day(&elements, n, ORBITS_BENCH_EPOCH + d, reference);
+    }
+    bench_report("propagate_all_day", (double)n * dates, "bodies", bench_now() - start);
+
+    start = bench_now();
+    for (int d = 0; d < dates; d++) {
+        orbits_propagate_double(&full, ORBITS_BENCH_EPOCH + d, out, out + n, out + 2 * n);
+    }
+    bench_report("orbits double", (double)n * dates, "bodies", bench_now() - start);
+
+    start = bench_now();
+    for (int d = 0; d < dates; d++) {
+        orbits_propagate_float(&single, ORBITS_BENCH_EPOCH + d, out_float, out_float + n, out_float + 2 * n);
+    }
+    bench_report("orbits float", (double)n * dates, "bodies", bench_now() - start);
+
+    // Errors on the last date, against the dispatched double solver
+    double worst_double = 0, worst_float = 0;
+    for (size_t i = 0; i < n; i++) {
+        double dx = out[i] - reference[i].x;
+        double dy = out[n + i] - reference[i].y;
+        double dz = out[2 * n + i] - reference[i].z;
+        double error = sqrt(dx * dx + dy * dy + dz * dz);
+        worst_double = error > worst_double ? error : worst_double;
+        dx = out_float[i] - reference[i].x;
+        dy = out_float[n + i] - reference[i].y;
+        dz = out_float[2 * n + i] - reference[i].z;
+        error = sqrt(dx * dx + dy * dy + dz * dz);
+        worst_float = error > worst_float ? error : worst_float;
+    }
+    printf("\nmax error double %.3e AU, float %.3e AU\n", worst_double, worst_float);
+
+    free(reference);
+    free(out);
+    free(out_float);
+    orbits_free_double(&full);
+    orbits_free_float(&single);
+    elements_free(&elements);
+    return 0;
+}
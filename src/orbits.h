@@ -0,0 +1,63 @@
+#ifndef ORBITS_H
+#define ORBITS_H
+
+#include <stddef.h>
+#include "propagate.h"
+
+// Propagation in a chosen precision. The same kernel (orbits_kernel.h) is
+// compiled for float and for double, each for the same SSE2/AVX2/AVX-512
+// targets as the Kepler solvers, and follows kepler_solve's dispatch. Float
+// packs twice as many bodies per vector and is plenty for the ASCII views,
+// double is for analysis output. Elements are rebased on an epoch, so a
+// float only has to hold the time since the epoch instead of a full Julian
+// Date.
+#define ORBITS_FIELDS_OF(real)                                           \
+    size_t count;                                                        \
+    size_t capacity;                                                     \
+    double epoch;           /* Julian Date of mean_anomaly */            \
+    real *semi_major_axis;                                               \
+    real *semi_minor_axis;                                               \
+    real *eccentricity;                                                  \
+    real *mean_motion;                                                   \
+    real *mean_anomaly;     /* at the epoch, in [-PI, PI] */             \
+    real *px, *py, *pz;                                                  \
+    real *qx, *qy, *qz;                                                  \
+    int owned;
+
+typedef struct OrbitsFloat {
+    ORBITS_FIELDS_OF(float)
+} orbits_float_t;
+
+typedef struct OrbitsDouble {
+    ORBITS_FIELDS_OF(double)
+} orbits_double_t;
+
+// Number of per-body arrays, caller storage needs ORBITS_FIELDS * capacity reals
+#define ORBITS_FIELDS 11
+
+int orbits_init_float(orbits_float_t* orbits, size_t capacity);
+int orbits_init_double(orbits_double_t* orbits, size_t capacity);
+
+// Same as orbits_init_* but the arrays are carved out of storage
+void orbits_init_with_float(orbits_float_t* orbits, float* storage, size_t capacity);
+void orbits_init_with_double(orbits_double_t* orbits, double* storage, size_t capacity);
+void orbits_free_float(orbits_float_t* orbits);
+void orbits_free_double(orbits_double_t* orbits);
+
+// Convert every body in elements, with mean anomalies at the epoch. Dates
+// close to the epoch keep the most precision.
+int orbits_from_elements_float(orbits_float_t* orbits, const elements_t* elements, double epoch);
+int orbits_from_elements_double(orbits_double_t* orbits, const elements_t* elements, double epoch);
+
+// Heliocentric ecliptic x/y/z of every body at a Julian Date, one array per axis
+void orbits_propagate_float(const orbits_float_t* orbits, double day, float* x, float* y, float* z);
+void orbits_propagate_double(const orbits_double_t* orbits, double day, double* x, double* y, double* z);
+
+// Instruction set the orbits_propagate_* functions dispatch to ("avx512",
+// "avx2", "sse2", "generic" off x86)
+const char* orbits_kernel_name(void);
+
+// "precision-bench" mode: both precisions against propagate_all_day
+int orbits_bench_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,202 @@
+// Propagation kernel, included by orbits.c once per precision and
+// instruction set with
+//   ORBITS_DOUBLE        0 for float, 1 for double
+//   ORBITS_SUFFIX        instruction set suffix (sse2, avx2, ...)
+//   ORBITS_TARGET        function attribute selecting the instruction set
+//   ORBITS_VECTOR_BYTES  vector width
+//   ORBITS_STORAGE       1 on one include per precision, for init/free and
+//                        the conversion from elements_t
+// sin/cos and the Halley iterations come from kepler_vector.h, the same
+// code as the Kepler kernels, with the polynomials cut to float for float.
+// No include guard on purpose.
+
+#if ORBITS_DOUBLE
+#define ORBITS_REAL double
+#define ORBITS_TYPE double
+#define ORBITS_INT long long
+#define ORBITS_PRECISE 1
+#define ORBITS_ITERATIONS KEPLER_ITERATIONS
+#define ORBITS_ROUND_MAGIC 6755399441055744.0     // 1.5 * 2^52
+#define ORBITS_PIO2_HI 1.57079632673412561417e+00 // first 33 bits of PI/2
+#define ORBITS_PIO2_LO 6.07710050650619224932e-11 // PI/2 - ORBITS_PIO2_HI
+#else
+#define ORBITS_REAL float
+#define ORBITS_TYPE float
+#define ORBITS_INT int
+#define ORBITS_PRECISE 0
+#define ORBITS_ITERATIONS 4
+#define ORBITS_ROUND_MAGIC 12582912.0f // 1.5 * 2^23
+#define ORBITS_PIO2_HI 1.5703125f       // 8 bits, exact times any small q
+#define ORBITS_PIO2_LO 4.8382679e-4f    // PI/2 - ORBITS_PIO2_HI
+#endif
+
+#define ORBITS_PASTE2(a, b) a##_##b
+#define ORBITS_PASTE(a, b) ORBITS_PASTE2(a, b)
+#define ORBITS_FN(name) ORBITS_PASTE(name, ORBITS_TYPE)
+#define ORBITS_KERNEL(name) ORBITS_PASTE(ORBITS_FN(name), ORBITS_SUFFIX)
+#define ORBITS_T ORBITS_PASTE(ORBITS_FN(orbits), t)
+#define ORBITS_VEC ORBITS_KERNEL(vreal)
+#define ORBITS_IVEC ORBITS_KERNEL(vint)
+#define ORBITS_LANES (ORBITS_VECTOR_BYTES / sizeof(ORBITS_REAL))
+#define C(x) ((ORBITS_REAL)(x))
+
+#if ORBITS_STORAGE
+int ORBITS_FN(orbits_init)(ORBITS_T* orbits, size_t capacity) {
+    ORBITS_REAL* storage = malloc(ORBITS_FIELDS * capacity * sizeof(ORBITS_REAL));
+    if (storage == NULL) {
+        fprintf(stderr, "not enough memory for %zu bodies\n", capacity);
+        return -1;
+    }
+    ORBITS_FN(orbits_init_with)(orbits, storage, capacity);
+    orbits->owned = 1;
+    return 0;
+}
+
+void ORBITS_FN(orbits_init_with)(ORBITS_T* orbits, ORBITS_REAL* storage, size_t capacity) {
+    orbits->count = 0;
+    orbits->capacity = capacity;
+    orbits->epoch = 0;
+    orbits->owned = 0;
+    orbits->semi_major_axis = storage;
+    orbits->semi_minor_axis = storage + capacity;
+    orbits->eccentricity = storage + 2 * capacity;
+    orbits->mean_motion = storage + 3 * capacity;
+    orbits->mean_anomaly = storage + 4 * capacity;
+    orbits->px = storage + 5 * capacity;
+    orbits->py = storage + 6 * capacity;
+    orbits->pz = storage + 7 * capacity;
+    orbits->qx = storage + 8 * capacity;
+    orbits->qy = storage + 9 * capacity;
+    orbits->qz = storage + 10 * capacity;
+}
+
+void ORBITS_FN(orbits_free)(ORBITS_T* orbits) {
+    if (orbits->owned) {
+        free(orbits->semi_major_axis); // start of the single block
+    }
+    orbits->semi_major_axis = orbits->semi_minor_axis = orbits->eccentricity = NULL;
+    orbits->mean_motion = orbits->mean_anomaly = NULL;
+    orbits->px = orbits->py = orbits->pz = NULL;
+    orbits->qx = orbits->qy = orbits->qz = NULL;
+    orbits->count = 0;
+    orbits->capacity = 0;
+}
+
+int ORBITS_FN(orbits_from_elements)(ORBITS_T* orbits, const elements_t* elements, double epoch) {
+    if (elements->count > orbits->capacity) {
+        return -1;
+    }
+    orbits->count = elements->count;
+    orbits->epoch = epoch;
+    for (size_t i = 0; i < elements->count; i++) {
+        // Reduced in double, before anything is rounded to the kernel's precision
+        double m = elements->mean_motion[i] * (epoch - elements->perihelion_day[i]);
+        orbits->mean_anomaly[i] = (ORBITS_REAL)(m - ORBITS_2PI * nearbyint(m / ORBITS_2PI));
+        orbits->semi_major_axis[i] = (ORBITS_REAL)elements->semi_major_axis[i];
+        orbits->semi_minor_axis[i] = (ORBITS_REAL)elements->semi_minor_axis[i];
+        orbits->eccentricity[i] = (ORBITS_REAL)elements->eccentricity[i];
+        orbits->mean_motion[i] = (ORBITS_REAL)elements->mean_motion[i];
+        orbits->px[i] = (ORBITS_REAL)elements->px[i];
+        orbits->py[i] = (ORBITS_REAL)elements->py[i];
+        orbits->pz[i] = (ORBITS_REAL)elements->pz[i];
+        orbits->qx[i] = (ORBITS_REAL)elements->qx[i];
+        orbits->qy[i] = (ORBITS_REAL)elements->qy[i];
+        orbits->qz[i] = (ORBITS_REAL)elements->qz[i];
+    }
+    return 0;
+}
+#endif
+
+typedef ORBITS_REAL ORBITS_VEC __attribute__((vector_size(ORBITS_VECTOR_BYTES)));
+typedef ORBITS_INT ORBITS_IVEC __attribute__((vector_size(ORBITS_VECTOR_BYTES)));
+
+#define VECTOR_FN ORBITS_KERNEL
+#define VECTOR_REAL ORBITS_REAL
+#define VECTOR_T ORBITS_VEC
+#define VECTOR_IT ORBITS_IVEC
+#define VECTOR_TARGET ORBITS_TARGET
+#define VECTOR_PRECISE ORBITS_PRECISE
+#define VECTOR_ROUND_MAGIC ORBITS_ROUND_MAGIC
+#define VECTOR_PIO2_HI ORBITS_PIO2_HI
+#define VECTOR_PIO2_LO ORBITS_PIO2_LO
+#include "kepler_vector.h"
+#undef VECTOR_FN
+#undef VECTOR_REAL
+#undef VECTOR_T
+#undef VECTOR_IT
+#undef VECTOR_TARGET
+#undef VECTOR_PRECISE
+#undef VECTOR_ROUND_MAGIC
+#undef VECTOR_PIO2_HI
+#undef VECTOR_PIO2_LO
+
+// Lanes [i, i + count) of a field, zero past the end so the tail goes
+// through the same code as full vectors
+ORBITS_TARGET static inline ORBITS_VEC ORBITS_KERNEL(vload)(const ORBITS_REAL* field, size_t i, size_t count) {
+    ORBITS_VEC v = {0};
+    if (count == ORBITS_LANES) {
+        memcpy(&v, field + i, sizeof(v));
+    } else {
+        memcpy(&v, field + i, count * sizeof(ORBITS_REAL));
+    }
+    return v;
+}
+
+ORBITS_TARGET static inline void ORBITS_KERNEL(vstore)(ORBITS_REAL* out, size_t i, size_t count, ORBITS_VEC v) {
+    if (count == ORBITS_LANES) {
+        memcpy(out + i, &v, sizeof(v));
+    } else {
+        memcpy(out + i, &v, count * sizeof(ORBITS_REAL));
+    }
+}
+
+ORBITS_TARGET static void ORBITS_KERNEL(orbits_propagate)(const ORBITS_T* orbits, double day, ORBITS_REAL* x,
+                                                          ORBITS_REAL* y, ORBITS_REAL* z) {
+    // Only the time since the epoch is rounded to the kernel's precision
+    ORBITS_REAL dt = (ORBITS_REAL)(day - orbits->epoch);
+    size_t n = orbits->count;
+
+    for (size_t i = 0; i < n; i += ORBITS_LANES) {
+        size_t count = n - i < ORBITS_LANES ? n - i : ORBITS_LANES;
+        ORBITS_VEC e = ORBITS_KERNEL(vload)(orbits->eccentricity, i, count);
+        ORBITS_VEC m = ORBITS_KERNEL(vload)(orbits->mean_anomaly, i, count) +
+                       ORBITS_KERNEL(vload)(orbits->mean_motion, i, count) * dt;
+
+        // Reduce M to [-PI, PI], only sin E and cos E are needed afterwards
+        ORBITS_VEC turns = (m * C(0.15915494309189533577) + ORBITS_ROUND_MAGIC) - ORBITS_ROUND_MAGIC;
+        m = (m - turns * (4 * ORBITS_PIO2_HI)) - turns * (4 * ORBITS_PIO2_LO);
+
+        ORBITS_VEC s, c;
+        ORBITS_KERNEL(vsincos)(ORBITS_KERNEL(vkepler)(m, e, ORBITS_ITERATIONS), &s, &c);
+
+        ORBITS_VEC along = ORBITS_KERNEL(vload)(orbits->semi_major_axis, i, count) * (c - e);
+        ORBITS_VEC across = ORBITS_KERNEL(vload)(orbits->semi_minor_axis, i, count) * s;
+        ORBITS_VEC ox = along * ORBITS_KERNEL(vload)(orbits->px, i, count) +
+                        across * ORBITS_KERNEL(vload)(orbits->qx, i, count);
+        ORBITS_VEC oy = along * ORBITS_KERNEL(vload)(orbits->py, i, count) +
+                        across * ORBITS_KERNEL(vload)(orbits->qy, i, count);
+        ORBITS_VEC oz = along * ORBITS_KERNEL(vload)(orbits->pz, i, count) +
+                        across * ORBITS_KERNEL(vload)(orbits->qz, i, count);
+        ORBITS_KERNEL(vstore)(x, i, count, ox);
+        ORBITS_KERNEL(vstore)(y, i, count, oy);
+        ORBITS_KERNEL(vstore)(z, i, count, oz);
+    }
+}
+
+#undef C
+#undef ORBITS_LANES
+#undef ORBITS_IVEC
+#undef ORBITS_VEC
+#undef ORBITS_T
+#undef ORBITS_KERNEL
+#undef ORBITS_FN
+#undef ORBITS_PASTE
+#undef ORBITS_PASTE2
+#undef ORBITS_PIO2_LO
+#undef ORBITS_PIO2_HI
+#undef ORBITS_ROUND_MAGIC
+#undef ORBITS_ITERATIONS
+#undef ORBITS_PRECISE
+#undef ORBITS_INT
+#undef ORBITS_TYPE
+#undef ORBITS_REAL
@@ -4,152 +4,24 @@
 #include <string.h>
 #include "planets.h"
 #include "cJSON.h"
+#include "propagate.h"
+#include "kepler.h"
+#include "series.h"
+#include "ephemeris.h"
+#include "sweep.h"
+#include "nbody.h"
+#include "julian.h"
+#include "events.h"
+#include "approach.h"
+#include "orbits.h"
+#include "fetch.h"
+#include "catalog.h"
+#include "mpc.h"
+#include "mock.h"
+#include "json_arena.h"
+#include "bench.h"
 #include <time.h>
 #include <math.h>
-#define PI 3.141592654
-#define GRID_WIDTH 150
-#define GRID_HEIGHT 40
-#define MAX_RANGE 35.0 // in AU, adjust as needed
-
-// Coordinates
-typedef struct Coordinates {
-    double x;
-    double y;
-} coordinates_t;
-
-typedef struct Date {
-    int day;
-    int month;
-    int year;
-} date_t;
-
-// Planet info
-typedef struct Planets {
-    char name[15];
-    float mass;
-    float radius;
-    float period;
-    float semi_major_axis;
-    float temperature;
-    float distance_light_year;
-    float eccentricity; // manually set
-    date_t perihelion_date; // date of last perihelion
-    int days_since_perihelion;
-    double mean_anomaly;
-    double eccentric_anomaly;
-    double radial_distance;
-    double true_anomaly;
-    coordinates_t coordinates;
-    char symbol; // symbol for ASCII representation
-} planet_t;
-
-// API tutorial
-struct MemoryStruct {
-  char *memory;
-  size_t size;
-};
-
-// Processing JSON info
-cJSON *get_data_from_json(cJSON *json_item, char *info) {
-    cJSON *json_info = cJSON_GetObjectItemCaseSensitive(json_item, info);
-    return json_info;
-}
-
-// More API/JSON tutorial
-static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-  size_t realsize = size * nmemb;
-  struct MemoryStruct *mem = (struct MemoryStruct *)userp;
-  
-  char *ptr = realloc(mem->memory, mem->size + realsize + 1);
-  if(!ptr) 
-  {
-    printf("not enough memory (realloc returned NULL)\n");
-    return 0;
-  }
- 
-  mem->memory = ptr;
-  memcpy(&(mem->memory[mem->size]), contents, realsize);
-  mem->size += realsize;
-  mem->memory[mem->size] = 0;
- 
-  return realsize;
-}
-
-// API call for planet data
-planet_t retrieve_planet_t(char *planet_name) {
-    
-    char* api_key = "V4hB8TpUJAg1cV1+J5/DVA==iHCe8S41JONK282u";
-    char* base_url = "https://api.api-ninjas.com/v1/planets?name=";
-    char* api_url = malloc(256 * sizeof(char));
-    
-    strcpy(api_url, base_url);
-    strcat(api_url, planet_name);
-
-    // Initialize CURL
-    CURL *curl;
-    CURLcode result;
-    struct MemoryStruct chunk;
-    chunk.memory = malloc(1);
-    chunk.size = 0;
-
-    curl = curl_easy_init();
-    if (curl == NULL) {
-        fprintf(stderr, "HTTP request failed\n");  
-        free(chunk.memory);
-        //return NULL;
-    }
-
-    // Headers
-    struct curl_slist *headers = NULL;
-    char header[256];
-    sprintf(header, "X-Api-Key: %s", api_key);
-    headers = curl_slist_append(headers, header);
-
-
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_URL, api_url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
-
-    result = curl_easy_perform(curl);
-
-    if (result != CURLE_OK) {
-        fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(result));
-    }
-    
-    // printf("%s <--- response string\n", chunk.memory);
-    curl_easy_cleanup(curl);
-    free(api_url);
-    
-    // parse the JSON data
-    cJSON *json = cJSON_Parse(chunk.memory);
-    if (json == NULL) {
-        printf("Error: Failed to parse JSON\n");
-        exit(1); // Exit with an error code
-    }    
-
-    free(chunk.memory);
-
-    cJSON *json_item = cJSON_GetArrayItem(json, 0);
-    cJSON *name = get_data_from_json(json_item, "name");
-    cJSON *mass = get_data_from_json(json_item, "mass");
-    cJSON *radius = get_data_from_json(json_item, "radius");
-    cJSON *period = get_data_from_json(json_item, "period");
-    cJSON *semi_major_axis = get_data_from_json(json_item, "semi_major_axis");
-    cJSON *temperature = get_data_from_json(json_item, "temperature");
-    cJSON *distance_light_year = get_data_from_json(json_item, "distance_light_year");
-
-    planet_t data;
-    strcpy(data.name, name->valuestring);
-    data.mass = mass->valuedouble * 100;
-    data.radius = radius->valuedouble * 100;
-    data.period = period->valuedouble;
-    data.semi_major_axis = semi_major_axis->valuedouble;
-    data.temperature = temperature->valuedouble;
-    data.distance_light_year = distance_light_year->valuedouble;
-
-    return data;
-}
 
 // Setting the mean anomaly for planet
 void set_mean_anomaly_ptr(planet_t * planet_ptr) {
@@ -158,8 +30,9 @@ void set_mean_anomaly_ptr(planet_t * planet_ptr) {
 
 // Setting the eccentric anomaly for planet
 void set_eccentric_anomaly(planet_t* planet_ptr) { 
-    // using approximation E≈M+esinM
-    planet_ptr->eccentric_anomaly = (double) planet_ptr->mean_anomaly + planet_ptr->eccentricity * sin(planet_ptr->mean_anomaly);
+    // solving M = E - e sin(E) instead of the approximation E≈M+esinM
+    double e = planet_ptr->eccentricity;
+    kepler_solve(&planet_ptr->mean_anomaly, &e, &planet_ptr->eccentric_anomaly, NULL, NULL, 1);
 }
 
 // Setting the radial distance for planet
@@ -186,8 +59,16 @@ void set_coordinates(planet_t* planet_ptr) {
     set_eccentric_anomaly(planet_ptr); 
     set_radial_distance(planet_ptr);
     set_true_anomaly(planet_ptr);
-    planet_ptr->coordinates.x = planet_ptr->radial_distance * cos(planet_ptr->true_anomaly);
-    planet_ptr->coordinates.y = planet_ptr->radial_distance * sin(planet_ptr->true_anomaly);
+
+    // Position in the orbital plane, then rotated into the ecliptic frame
+    double p[3], q[3];
+    double along = planet_ptr->radial_distance * cos(planet_ptr->true_anomaly);
+    double across = planet_ptr->radial_distance * sin(planet_ptr->true_anomaly);
+    orbit_orientation(planet_ptr->inclination * DEGREES, planet_ptr->ascending_node * DEGREES,
+                      planet_ptr->argument_of_perihelion * DEGREES, p, q);
+    planet_ptr->coordinates.x = along * p[0] + across * q[0];
+    planet_ptr->coordinates.y = along * p[1] + across * q[1];
+    planet_ptr->coordinates.z = along * p[2] + across * q[2];
 }
 
 // Function to calculate the number of days in a month
@@ -209,25 +90,37 @@ int daysInMonth(int month, int year) {
     }
 }
 
+// Julian Date used for all perihelion arithmetic
+double date_to_julian(const date_t* date) {
+    return julian_date(date->year, date->month, date->day, date->hour, date->minute, 0);
+}
+
 // Calculate number of days since/to perihelion
 void set_days_since_perihelion(planet_t* planet_ptr, date_t* user_date) {
 
-    int days1 = planet_ptr->perihelion_date.day + (planet_ptr->perihelion_date.month - 1) * daysInMonth(planet_ptr->perihelion_date.month, planet_ptr->perihelion_date.year) + planet_ptr->perihelion_date.year * 365;
-    int days2 = user_date->day + (user_date->month - 1) * daysInMonth(user_date->month, user_date->year) + user_date->year * 365;
+    double days1 = date_to_julian(&planet_ptr->perihelion_date);
+    double days2 = date_to_julian(user_date);
 
     planet_ptr->days_since_perihelion =  (days2 - days1);
 
 }
 
-// Draw orbital ellipse for a planet with specific scale
+// Draw orbital ellipse for a planet with specific scale.
+// The views look down on the ecliptic: the 3D orbit is projected by dropping z.
 void draw_orbit(char grid[GRID_HEIGHT][GRID_WIDTH], planet_t* planet, double max_range) {
     double a = planet->semi_major_axis;  // semi-major axis
-    double b = a * sqrt(1 - planet->eccentricity * planet->eccentricity);  // semi-minor axis
+    double e = planet->eccentricity;
+    double b = a * sqrt(1 - e * e);  // semi-minor axis
+    double p[3], q[3];
+    orbit_orientation(planet->inclination * DEGREES, planet->ascending_node * DEGREES,
+                      planet->argument_of_perihelion * DEGREES, p, q);
     
-    // Draw ellipse using parametric equations
+    // Draw ellipse using parametric equations, the Sun at a focus
     for (double theta = 0; theta < 2 * PI; theta += 0.05) {
-        double x = a * cos(theta);
-        double y = b * sin(theta);
+        double along = a * (cos(theta) - e);
+        double across = b * sin(theta);
+        double x = along * p[0] + across * q[0];
+        double y = along * p[1] + across * q[1];
         
         // Convert to grid coordinates
         int grid_x = (int)((x + max_range) * GRID_WIDTH / (2 * max_range));
@@ -265,7 +158,7 @@ void draw_solar_system_with_scale(planet_t* planets[], int num_planets, double m
         grid[sun_y][sun_x] = '*';
     }
     
-    // Place planets (only those within range)
+    // Place planets (only those within range), projected onto the ecliptic
     for (int i = 0; i < num_planets; i++) {
         double planet_dist = sqrt(planets[i]->coordinates.x * planets[i]->coordinates.x + 
                                  planets[i]->coordinates.y * planets[i]->coordinates.y);
@@ -314,101 +207,372 @@ void draw_solar_system_dual_view(planet_t* planets[], char* date) {
     draw_solar_system_with_scale((planet_t* []){planets[4], planets[5], planets[6], planets[7]}, 4, 35.0);
 }
 
-int main() {
+// Built-in elements for the eight planets, so the default run needs neither
+// the network nor the heap. Semi-major axis (AU), period (days) and mass
+// (Jupiter masses) match what the API returns.
+typedef struct PlanetElements {
+    char name[15];
+    char symbol; // symbol for ASCII representation
+    float semi_major_axis;
+    float period;
+    float eccentricity; // source: https://nssdc.gsfc.nasa.gov/planetary/factsheet/
+    float mass;
+    date_t perihelion_date; // date of last perihelion
+    // orientation in degrees, source: https://ssd.jpl.nasa.gov/planets/approx_pos.html (J2000)
+    float inclination;
+    float ascending_node;
+    float argument_of_perihelion; // longitude of perihelion - ascending node
+} planet_elements_t;
+
+static const planet_elements_t planet_table[NUM_PLANETS] = {
+    // source https://ssd.jpl.nasa.gov/horizons/app.html#/ -> by enabling the "heliocentric range & range rate" setting in the output, and recording what times that reaches a minimum
+    {"Mercury", 'M', 0.387, 88.0, 0.2056, 0.000174, {3, 6, 2025, 0, 0}, 7.004, 48.331, 29.127},
+    // source https://ssd.jpl.nasa.gov/horizons/app.html#/
+    {"Venus", 'V', 0.723, 224.7, 0.0068, 0.00256, {20, 2, 2025, 0, 0}, 3.395, 76.680, 54.923},
+    // source https://www.timeanddate.com/astronomy/perihelion-aphelion-solstice.html
+    {"Earth", 'E', 1.0, 365.2, 0.0167, 0.00315, {4, 1, 2025, 0, 0}, 0.0, 0.0, 102.938},
+    // source https://ssd.jpl.nasa.gov/horizons/app.html#/, 'M' is taken by Mercury
+    {"Mars", 'R', 1.524, 687.0, 0.0934, 0.000338, {9, 5, 2024, 0, 0}, 1.850, 49.560, 286.497},
+    // source wikipedia (confirmed by https://ssd.jpl.nasa.gov/horizons/app.html#/)
+    {"Jupiter", 'J', 5.203, 4331.0, 0.0489, 1.0, {21, 1, 2023, 0, 0}, 1.304, 100.474, 274.255},
+    // source wikipedia (confirmed by https://ssd.jpl.nasa.gov/horizons/app.html#/)
+    {"Saturn", 'S', 9.537, 10747.0, 0.0565, 0.299, {29, 11, 2032, 0, 0}, 2.486, 113.662, 338.937},
+    // source wikipedia (too lazy to confirm)
+    {"Uranus", 'U', 19.19, 30589.0, 0.0463, 0.0457, {19, 8, 2050, 0, 0}, 0.773, 74.017, 96.937},
+    // source wikipedia (too lazy to confirm)
+    {"Neptune", 'N', 30.07, 59800.0, 0.0086, 0.0540, {4, 9, 2042, 0, 0}, 1.770, 131.784, 273.180},
+};
+
+// Elements the API doesn't provide, from the built-in table
+static void set_table_elements(planet_t* planet, const planet_elements_t* elements) {
+    planet->eccentricity = elements->eccentricity;
+    planet->perihelion_date = elements->perihelion_date;
+    planet->inclination = elements->inclination;
+    planet->ascending_node = elements->ascending_node;
+    planet->argument_of_perihelion = elements->argument_of_perihelion;
+    planet->symbol = elements->symbol;
+}
+
+// The eight planets from the built-in table
+void load_planet_table(planet_t* planets[]) {
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        const planet_elements_t* elements = &planet_table[i];
+        memset(planets[i], 0, sizeof(planet_t));
+        memcpy(planets[i]->name, elements->name, sizeof(planets[i]->name));
+        planets[i]->semi_major_axis = elements->semi_major_axis;
+        planets[i]->period = elements->period;
+        planets[i]->mass = elements->mass * 100; // same scale as planet_from_json
+        set_table_elements(planets[i], elements);
+    }
+}
+
+// Fetch the eight planets concurrently and fill in the elements the API
+// doesn't provide. A planet whose request failed keeps its table entry.
+void fetch_planets(planet_t* planets[]) {
+    const char* names[NUM_PLANETS];
+    planet_t fetched[NUM_PLANETS];
+    int ok[NUM_PLANETS];
+    fetch_stats_t stats;
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        names[i] = planet_table[i].name;
+    }
+    fetch_planet_list(names, NUM_PLANETS, fetched, ok, &stats);
+    fprintf(stderr, "fetched %zu of %zu planets in %.1f ms (cache: %zu hits, %zu revalidated, %zu misses; "
+            "%zu retries, %zu hedges, %zu won; %zu queued for %.1f ms)\n",
+            stats.requests - stats.failed, stats.requests, 1000 * stats.seconds,
+            stats.cache_hits, stats.cache_revalidated, stats.cache_misses,
+            stats.retries, stats.hedges, stats.hedges_won, stats.queued, 1000 * stats.queued_seconds);
+
+    load_planet_table(planets);
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        if (ok[i]) {
+            *planets[i] = fetched[i];
+            set_table_elements(planets[i], &planet_table[i]);
+        }
+    }
+}
+
+// Planets from the built-in table, or from the API when PLANETS_SOURCE=api
+void load_planets(planet_t* planets[]) {
+    const char* source = getenv("PLANETS_SOURCE");
+    if (source != NULL && strcmp(source, "api") == 0) {
+        fetch_planets(planets);
+    } else {
+        load_planet_table(planets);
+    }
+}
+
+static void* load_planets_thread(void* arg) {
+    planet_load_t* load = arg;
+    fetch_planets(load->planets);
+    load->finished = bench_now();
+    return NULL;
+}
+
+// Only the API is worth a thread, the table is ready at once
+void load_planets_start(planet_load_t* load, planet_t* planets[]) {
+    const char* source = getenv("PLANETS_SOURCE");
+    load->planets = planets;
+    load->started = bench_now();
+    load->threaded = source != NULL && strcmp(source, "api") == 0 &&
+                     pthread_create(&load->thread, NULL, load_planets_thread, load) == 0;
+    if (!load->threaded) {
+        load_planets(planets);
+        load->finished = bench_now();
+    }
+}
+
+double load_planets_join(planet_load_t* load) {
+    double start = bench_now();
+    if (load->threaded) {
+        pthread_join(load->thread, NULL);
+        load->threaded = 0;
+    }
+    return bench_now() - start;
+}
+
+// Parse a dd/mm/yyyy date with an optional Thh:mm time, returns 0 when valid
+int parse_date(const char* text, date_t* date) {
+    int day, month, year, hour = 0, minute = 0;
+    int fields = sscanf(text, "%d/%d/%dT%d:%d", &day, &month, &year, &hour, &minute);
+    if (fields != 3 && fields != 5) {
+        return -1;
+    }
+
+    // write some validations for me
+    if (day < 1 || day > 31 || month < 1 || month > 12 || year < 1000) {
+        return -1;
+    }
+    if (day > daysInMonth(month, year) || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return -1;
+    }
+
+    *date = (date_t){day, month, year, hour, minute};
+    return 0;
+}
+
+// Set the coordinates of the eight planets on a date, with the Keplerian
+// model or by integrating the N-body system from its epoch
+int compute_positions(planet_t* planets[], const date_t* date, int use_nbody) {
+    elements_t elements;
+    double storage[ELEMENTS_FIELDS * NUM_PLANETS];
+    coordinates_t positions[NUM_PLANETS];
+    elements_init_with(&elements, storage, NUM_PLANETS);
+    if (elements_from_planets(&elements, planets, NUM_PLANETS) != 0) {
+        return -1;
+    }
+
+    if (use_nbody) {
+        nbody_t system;
+        double gm[NUM_PLANETS];
+        for (int i = 0; i < NUM_PLANETS; i++) {
+            gm[i] = nbody_planet_gm(planets[i]);
+        }
+        if (nbody_init(&system, NUM_PLANETS + 1) != 0 ||
+            nbody_from_elements(&system, &elements, gm, NUM_PLANETS, NBODY_EPOCH_DAY) != 0) {
+            elements_free(&elements);
+            return -1;
+        }
+        nbody_advance(&system, date_to_julian(date), NBODY_DEFAULT_STEP, 1);
+        nbody_heliocentric(&system, positions);
+        nbody_free(&system);
+    } else {
+        // A character cell is hundredths of an AU, float is plenty
+        orbits_float_t orbits;
+        float orbit_storage[ORBITS_FIELDS * NUM_PLANETS];
+        float x[NUM_PLANETS], y[NUM_PLANETS], z[NUM_PLANETS];
+        double day = date_to_julian(date);
+        orbits_init_with_float(&orbits, orbit_storage, NUM_PLANETS);
+        orbits_from_elements_float(&orbits, &elements, day);
+        orbits_propagate_float(&orbits, day, x, y, z);
+        for (int i = 0; i < NUM_PLANETS; i++) {
+            positions[i] = (coordinates_t){x[i], y[i], z[i]};
+        }
+    }
+    elements_free(&elements);
+
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i]->coordinates = positions[i];
+    }
+    return 0;
+}
+
+// "show dd/mm/yyyy [kepler|nbody]": render a date without the prompt
+static int show_command(int argc, char *argv[]) {
+    date_t date;
+    int use_nbody = argc > 2 && strcmp(argv[2], "nbody") == 0;
+    if (argc < 2 || parse_date(argv[1], &date) != 0 || (argc > 2 && !use_nbody && strcmp(argv[2], "kepler") != 0)) {
+        fprintf(stderr, "usage: planets show dd/mm/yyyy [kepler|nbody]\n");
+        return 1;
+    }
+
+    planet_t planet_data[NUM_PLANETS];
+    planet_t* planets[NUM_PLANETS];
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i] = &planet_data[i];
+    }
+    load_planets(planets);
+
+    if (compute_positions(planets, &date, use_nbody) != 0) {
+        return 1;
+    }
+    draw_solar_system_dual_view(planets, argv[1]);
+    return 0;
+}
+
+// "startup-bench dd/mm/yyyy [table|api]": time from launch to the first frame,
+// split into loading the planets, propagating and drawing
+static int startup_bench_command(int argc, char *argv[]) {
+    date_t date;
+    int use_api = argc > 2 && strcmp(argv[2], "api") == 0;
+    if (argc < 2 || parse_date(argv[1], &date) != 0 || (argc > 2 && !use_api && strcmp(argv[2], "table") != 0)) {
+        fprintf(stderr, "usage: planets startup-bench dd/mm/yyyy [table|api]\n");
+        return 1;
+    }
+
+    double start = bench_now();
+    planet_t planet_data[NUM_PLANETS];
+    planet_t* planets[NUM_PLANETS];
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i] = &planet_data[i];
+    }
+    if (use_api) {
+        fetch_planets(planets);
+    } else {
+        load_planet_table(planets);
+    }
+    double loaded = bench_now();
+
+    if (compute_positions(planets, &date, 0) != 0) {
+        return 1;
+    }
+    double computed = bench_now();
+
+    draw_solar_system_dual_view(planets, argv[1]);
+    fflush(stdout);
+    double drawn = bench_now();
+
+    fprintf(stderr, "planets from %s: load %.3f ms, propagate %.3f ms, draw %.3f ms, first frame after %.3f ms\n",
+            use_api ? "the API" : "the built-in table", (loaded - start) * 1e3,
+            (computed - loaded) * 1e3, (drawn - computed) * 1e3, (drawn - start) * 1e3);
+    return 0;
+}
+
+// Batch modes, selected by the first command line argument.
+// With no arguments the program runs the interactive date prompt.
+typedef struct Command {
+    const char *name;
+    const char *args;
+    int (*run)(int argc, char *argv[]);
+    const char *help;
+} command_t;
+
+static int help_command(int argc, char *argv[]);
+
+static const command_t commands[] = {
+    {"help", "", help_command, "list these modes"},
+    {"show", "dd/mm/yyyy [kepler|nbody]", show_command, "render a date with the Keplerian or N-body model"},
+    {"bench", "[bodies] [dates]", propagate_bench_command, "batch propagation throughput"},
+    {"kepler-bench", "[bodies] [max_eccentricity]", kepler_bench_command, "Kepler solver speed and accuracy"},
+    {"series", "dd/mm/yyyy dd/mm/yyyy step_days", series_command, "stream positions over a date range"},
+    {"series-bench", "[steps] [increment]", series_bench_command, "series accuracy by eccentricity vs propagate_all_day"},
+    {"ephem-build", "file [start_year] [end_year] [degree] [segments]", ephemeris_build_command, "write a Chebyshev ephemeris cache"},
+    {"ephem-bench", "file [queries]", ephemeris_bench_command, "cache accuracy and speed vs direct propagation"},
+    {"sweep", "dd/mm/yyyy dd/mm/yyyy step_days [threads] [bodies|catalog_file] [file]", sweep_command, "parallel (date, body) sweep"},
+    {"sweep-scaling", "dd/mm/yyyy dd/mm/yyyy step_days [max_threads] [bodies|catalog_file]", sweep_scaling_command, "sweep scaling from 1 to N threads"},
+    {"nbody-bench", "[particles] [years] [threads]", nbody_bench_command, "leapfrog N-body speed and energy drift"},
+    {"julian-bench", "[count]", julian_bench_command, "calendar and timestamp to Julian Date throughput"},
+    {"events", "dd/mm/yyyy dd/mm/yyyy [step_days] [threads]", events_command, "conjunctions, oppositions and greatest elongations"},
+    {"approach", "dd/mm/yyyy dd/mm/yyyy radius_au [step_days] [bodies|catalog_file] [threads] [target]", approach_command, "close approaches found with a spatial grid"},
+    {"startup-bench", "dd/mm/yyyy [table|api]", startup_bench_command, "time to first frame"},
+    {"precision-bench", "[bodies] [dates]", orbits_bench_command, "float and double propagation kernels vs propagate_all_day"},
+    {"fetch-bench", "[rounds]", fetch_bench_command, "serial vs concurrent API requests"},
+    {"catalog-build", "catalog_file [json_file]", catalog_build_command, "write a binary catalog snapshot"},
+    {"catalog-bench", "[bodies] [prefix]", catalog_bench_command, "startup from JSON vs a mapped catalog"},
+    {"mpc-load", "file [threads] [catalog_file]", mpc_load_command, "parallel MPCORB loader"},
+    {"mpc-bench", "[lines] [threads] [file]", mpc_bench_command, "MPCORB loading on one thread vs every core"},
+    {"mock-api", "[port] [latency_ms] [bandwidth_kbps] [error_rate] [slow_rate] [recordings_dir]", mock_api_command, "local stand-in for the planets API"},
+    {"api-bench", "[requests] [max_concurrency] [latency_ms] [bandwidth_kbps] [error_rate] [slow_rate]", api_bench_command, "fetch+parse throughput and latency by concurrency"},
+    {"json-bench", "[megabytes] [rounds]", json_bench_command, "cJSON parse+delete on the heap vs an arena"},
+    {"coalesce-bench", "[jobs] [rounds] [rate_limit] [latency_ms]", coalesce_bench_command, "single-flight and rate limiting under concurrent jobs"},
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+static void print_usage(FILE* out) {
+    fprintf(out, "  planets\n        interactive date prompt\n");
+    for (size_t i = 0; i < NUM_COMMANDS; i++) {
+        fprintf(out, "  planets %s%s%s\n        %s\n", commands[i].name, commands[i].args[0] != 0 ? " " : "",
+                commands[i].args, commands[i].help);
+    }
+}
+
+static int help_command(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Usage:\n");
+    print_usage(stdout);
+    return 0;
+}
+
+static int run_command(int argc, char *argv[]) {
+    for (size_t i = 0; i < NUM_COMMANDS; i++) {
+        if (strcmp(argv[1], commands[i].name) == 0) {
+            return commands[i].run(argc - 1, argv + 1);
+        }
+    }
+
+    fprintf(stderr, "Unknown command '%s'. Usage:\n", argv[1]);
+    print_usage(stderr);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc > 1) {
+        return run_command(argc, argv);
+    }
         
-    planet_t *mercury = malloc(sizeof(planet_t));
-    planet_t *venus = malloc(sizeof(planet_t));
-    planet_t *earth = malloc(sizeof(planet_t));          
-    planet_t *mars = malloc(sizeof(planet_t));
-    planet_t *jupiter = malloc(sizeof(planet_t));
-    planet_t *saturn = malloc(sizeof(planet_t));
-    planet_t *uranus = malloc(sizeof(planet_t));
-    planet_t *neptune = malloc(sizeof(planet_t));
-
-    // char* planet_name = "Mars";
-    *mercury = retrieve_planet_t("Mercury");
-    *venus = retrieve_planet_t("Venus");
-    *earth = retrieve_planet_t("Earth");
-    *mars = retrieve_planet_t("Mars");
-    *jupiter = retrieve_planet_t("Jupiter");
-    *saturn = retrieve_planet_t("Saturn");
-    *uranus = retrieve_planet_t("Uranus");
-    *neptune = retrieve_planet_t("Neptune");
-
-    // Manually setting eccentricities source: https://nssdc.gsfc.nasa.gov/planetary/factsheet/
-    mercury->eccentricity = 0.2056;
-    venus->eccentricity = 0.0068;
-    earth->eccentricity = 0.0167;
-    mars->eccentricity = 0.0934;
-    jupiter->eccentricity = 0.0489;
-    saturn->eccentricity = 0.0565;
-    uranus->eccentricity = 0.0463;
-    neptune->eccentricity = 0.0086;
-
-    // Manually setting perihelion dates. 
-
-    mercury->perihelion_date = (date_t){3, 6, 2025}; // source https://ssd.jpl.nasa.gov/horizons/app.html#/ -> by enabling the "heliocentric range & range rate" setting in the output, and recording what times that reaches a minimum
-    venus->perihelion_date = (date_t){20, 2, 2025}; // source https://ssd.jpl.nasa.gov/horizons/app.html#/
-    earth->perihelion_date = (date_t){4, 1, 2025}; // source https://www.timeanddate.com/astronomy/perihelion-aphelion-solstice.html
-    mars->perihelion_date = (date_t){9, 5, 2024}; // source https://ssd.jpl.nasa.gov/horizons/app.html#/
-    jupiter->perihelion_date = (date_t){21, 1, 2023}; // source wikipedia (confirmed by https://ssd.jpl.nasa.gov/horizons/app.html#/)
-    saturn->perihelion_date = (date_t){29, 11, 2032}; // source wikipedia (confirmed by https://ssd.jpl.nasa.gov/horizons/app.html#/)
-    uranus->perihelion_date = (date_t){19, 8, 2050}; // source wikipedia (too lazy to confirm)
-    neptune->perihelion_date = (date_t){4, 9, 2042}; // source wikipedia (too lazy to confirm)
-
-
-    // Symbols for planets
-    mercury->symbol = 'M';
-    venus->symbol = 'V';
-    earth->symbol = 'E';
-    mars->symbol = 'R';  // 'M' is taken by Mercury
-    jupiter->symbol = 'J';
-    saturn->symbol = 'S';
-    uranus->symbol = 'U';
-    neptune->symbol = 'N';
-
-    char user_date[11];
-    printf("Enter a date in the dd/mm/yyyy format:\n");
-    scanf("%10s", user_date);
+    planet_t planet_data[NUM_PLANETS];
+    planet_t* planets[NUM_PLANETS];
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i] = &planet_data[i];
+    }
+    // The fetch runs while the user types
+    planet_load_t load;
+    load_planets_start(&load, planets);
+
+    char user_date[17] = "";
+    printf("Enter a date in the dd/mm/yyyy or dd/mm/yyyyThh:mm format:\n");
+    fflush(stdout);
+    scanf("%16s", user_date);
     // char user_date[11] = "13/06/2025"; 
 
     
-    // Convert user_date to a struct tm
-    int day, month, year;
-    sscanf(user_date, "%d/%d/%d", &day, &month, &year);
-    
-    // write some validations for me
-    if (day < 1 || day > 31 || month < 1 || month > 12 || year < 1000) {
+    // Convert user_date to a date_t
+    date_t user_date_conv;
+    int valid = parse_date(user_date, &user_date_conv) == 0;
+    int threaded = load.threaded;
+    double waited = load_planets_join(&load);
+    if (threaded) {
+        double fetch = load.finished - load.started;
+        double hidden = fetch - waited > 0 ? fetch - waited : 0;
+        fprintf(stderr, "fetch took %.1f ms, %.1f ms of it hidden behind the prompt (waited %.1f ms)\n",
+                1000 * fetch, 1000 * hidden, 1000 * waited);
+    }
+    if (!valid) {
         fprintf(stderr, "Invalid date. Please enter a valid date in the dd/mm/yyyy format.\n");
         return 1;
     }
 
-    date_t user_date_conv = {day, month, year};
-
     // manual date before prod
     // date_t user_date_conv = {13, 7, 2025};
 
-    planet_t* planets[] = {mercury,venus,earth,mars,jupiter,saturn,uranus,neptune};
-        
-    for (int i = 0; i < 8; i++) {
-        set_days_since_perihelion(planets[i], &user_date_conv);
-        set_coordinates(planets[i]);
-        // printf("\n\nEccentric Anomaly (E) for %s: %f radians\n", planets[i]->name, planets[i]->eccentric_anomaly);
-        // printf("Radial Distance (r) for %s: %f AU\n", planets[i]->name, planets[i]->radial_distance);
-        // printf("cos(E): %f, sin(E): %f\n", cos(planets[i]->eccentric_anomaly), sin(planets[i]->eccentric_anomaly));
-        // printf("At %s, %s is located at (%f,%f) relative to the sun (0,0)\n\n", user_date, planets[i]->name, planets[i]->coordinates.x, planets[i]->coordinates.y);
+    if (compute_positions(planets, &user_date_conv, 0) != 0) {
+        return 1;
     }
 
     draw_solar_system_dual_view(planets, user_date);
 
-    free(mercury);
-    free(venus);
-    free(earth);
-    free(mars);
-    free(jupiter);
-    free(saturn);
-    free(uranus);
-    free(neptune);
-
     return 0;
 }
\ No newline at end of file
@@ -1,9 +1,80 @@
+#ifndef PLANETS_H
+#define PLANETS_H
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <curl/curl.h>
 #include <string.h>
+#include <pthread.h>
 #include "cJSON.h"
 
+#define PI 3.141592654
+#define GRID_WIDTH 150
+#define GRID_HEIGHT 40
+#define MAX_RANGE 35.0 // in AU, adjust as needed
+#define NUM_PLANETS 8
+
+// Coordinates, heliocentric ecliptic: x/y in the plane of Earth's orbit, z north of it
+typedef struct Coordinates {
+    double x;
+    double y;
+    double z;
+} coordinates_t;
+
+typedef struct Date {
+    int day;
+    int month;
+    int year;
+    int hour;   // optional, 0 when only the calendar day is given
+    int minute;
+} date_t;
+
+// Planet info
+typedef struct Planets {
+    char name[15];
+    float mass;
+    float radius;
+    float period;
+    float semi_major_axis;
+    float temperature;
+    float distance_light_year;
+    float eccentricity; // manually set
+    float inclination; // degrees, to the ecliptic
+    float ascending_node; // degrees, longitude of the ascending node
+    float argument_of_perihelion; // degrees
+    date_t perihelion_date; // date of last perihelion
+    double days_since_perihelion;
+    double mean_anomaly;
+    double eccentric_anomaly;
+    double radial_distance;
+    double true_anomaly;
+    coordinates_t coordinates;
+    char symbol; // symbol for ASCII representation
+} planet_t;
+
+void set_coordinates(planet_t* planet_ptr);
+int daysInMonth(int month, int year);
+double date_to_julian(const date_t* date);
+void set_days_since_perihelion(planet_t* planet_ptr, date_t* user_date);
+void draw_solar_system_dual_view(planet_t* planets[], char* date);
+void load_planets(planet_t* planets[]);
+void load_planet_table(planet_t* planets[]);
+void fetch_planets(planet_t* planets[]);
+
+// Planets loading in the background, so that an API fetch overlaps the
+// date prompt instead of coming before it
+typedef struct PlanetLoad {
+    planet_t **planets;
+    pthread_t thread;
+    int threaded;    // 0 when load_planets_start loaded them on the spot
+    double started;
+    double finished; // set by the loading thread
+} planet_load_t;
 
+void load_planets_start(planet_load_t* load, planet_t* planets[]);
+// Wait for the planets, returns the seconds spent waiting
+double load_planets_join(planet_load_t* load);
+int parse_date(const char* text, date_t* date);
+int compute_positions(planet_t* planets[], const date_t* date, int use_nbody);
 
-static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp);
+#endif
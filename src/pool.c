@@ -0,0 +1,152 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pool.h"
+
+// Chunks still owned by one thread, [next, end) in chunk indices
+typedef struct PoolQueue {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+    size_t steals;
+} pool_queue_t;
+
+typedef struct Pool {
+    int threads;
+    size_t total;
+    size_t chunk_size;
+    pool_task_fn fn;
+    void *context;
+    pool_queue_t *queues;
+} pool_t;
+
+typedef struct PoolWorker {
+    pool_t *pool;
+    int index;
+} pool_worker_t;
+
+int pool_default_threads(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+// Pop the next chunk from the front of a thread's own queue
+static int pool_take(pool_queue_t* queue, size_t* chunk) {
+    int found = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next < queue->end) {
+        *chunk = queue->next++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+// Move the upper half of some other thread's chunks into our own queue
+static int pool_steal(pool_t* pool, int thief) {
+    for (int offset = 1; offset < pool->threads; offset++) {
+        pool_queue_t* victim = &pool->queues[(thief + offset) % pool->threads];
+        size_t begin = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        size_t remaining = victim->end - victim->next;
+        if (remaining > 0) {
+            begin = victim->end - (remaining + 1) / 2;
+            end = victim->end;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (end > begin) {
+            pool_queue_t* own = &pool->queues[thief];
+            pthread_mutex_lock(&own->lock);
+            own->next = begin;
+            own->end = end;
+            own->steals++;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* pool_worker(void* arg) {
+    pool_worker_t* worker = arg;
+    pool_t* pool = worker->pool;
+    pool_queue_t* own = &pool->queues[worker->index];
+    size_t chunk;
+
+    // No new work appears once the pool is running, so a thread is done as
+    // soon as its own queue is empty and there is nothing left to steal
+    do {
+        while (pool_take(own, &chunk)) {
+            size_t begin = chunk * pool->chunk_size;
+            size_t end = begin + pool->chunk_size < pool->total ? begin + pool->chunk_size : pool->total;
+            pool->fn(pool->context, begin, end, worker->index);
+        }
+    } while (pool_steal(pool, worker->index));
+
+    return NULL;
+}
+
+int pool_run(int threads, size_t total, size_t chunk_size, pool_task_fn fn, void* context, pool_stats_t* stats) {
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+    if (chunk_size == 0) {
+        chunk_size = 1;
+    }
+    size_t chunks = (total + chunk_size - 1) / chunk_size;
+
+    pool_t pool = {threads, total, chunk_size, fn, context, NULL};
+    pool.queues = calloc(threads, sizeof(pool_queue_t));
+    pthread_t* handles = calloc(threads, sizeof(pthread_t));
+    pool_worker_t* workers = calloc(threads, sizeof(pool_worker_t));
+    if (!pool.queues || !handles || !workers) {
+        fprintf(stderr, "not enough memory for %d threads\n", threads);
+        free(pool.queues);
+        free(handles);
+        free(workers);
+        return -1;
+    }
+
+    // Even initial split, the first chunks % threads queues get one extra
+    size_t start = 0;
+    for (int t = 0; t < threads; t++) {
+        size_t share = chunks / threads + ((size_t)t < chunks % threads ? 1 : 0);
+        pthread_mutex_init(&pool.queues[t].lock, NULL);
+        pool.queues[t].next = start;
+        pool.queues[t].end = start + share;
+        start += share;
+        workers[t] = (pool_worker_t){&pool, t};
+    }
+
+    // The calling thread works as thread 0
+    int started = 1;
+    for (int t = 1; t < threads; t++, started++) {
+        if (pthread_create(&handles[t], NULL, pool_worker, &workers[t]) != 0) {
+            break; // the threads that did start steal the rest
+        }
+    }
+    pool_worker(&workers[0]);
+    for (int t = 1; t < started; t++) {
+        pthread_join(handles[t], NULL);
+    }
+
+    if (stats != NULL) {
+        stats->chunks = chunks;
+        stats->steals = 0;
+        for (int t = 0; t < threads; t++) {
+            stats->steals += pool.queues[t].steals;
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_mutex_destroy(&pool.queues[t].lock);
+    }
+    free(pool.queues);
+    free(handles);
+    free(workers);
+    return 0;
+}
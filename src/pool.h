@@ -0,0 +1,26 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Work-stealing pool over a range of items split into fixed-size chunks.
+// Each thread starts with an even share of the chunks and, once its own
+// share is done, steals the upper half of the next thread that still has
+// chunks left.
+//
+// fn is called with [begin, end) item ranges that never cross a chunk
+// boundary, plus the index of the calling thread.
+typedef void (*pool_task_fn)(void* context, size_t begin, size_t end, int thread);
+
+typedef struct PoolStats {
+    size_t chunks;
+    size_t steals;
+} pool_stats_t;
+
+// Thread count to use when the caller passes 0
+int pool_default_threads(void);
+
+// Run fn over [0, total) on threads threads and wait for it to finish
+int pool_run(int threads, size_t total, size_t chunk_size, pool_task_fn fn, void* context, pool_stats_t* stats);
+
+#endif
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "propagate.h"
+#include "kepler.h"
+#include "bench.h"
+
+// Bodies per Kepler solve, small enough for the scratch arrays to stay in L1
+#define PROPAGATE_BLOCK 256
+
+// Allocate every per-field array for up to capacity bodies
+int elements_init(elements_t* elements, size_t capacity) {
+    elements->count = 0;
+    elements->capacity = capacity;
+    elements->owned = 1;
+    elements->semi_major_axis = malloc(capacity * sizeof(double));
+    elements->semi_minor_axis = malloc(capacity * sizeof(double));
+    elements->eccentricity = malloc(capacity * sizeof(double));
+    elements->mean_motion = malloc(capacity * sizeof(double));
+    elements->perihelion_day = malloc(capacity * sizeof(double));
+    elements->px = malloc(capacity * sizeof(double));
+    elements->py = malloc(capacity * sizeof(double));
+    elements->pz = malloc(capacity * sizeof(double));
+    elements->qx = malloc(capacity * sizeof(double));
+    elements->qy = malloc(capacity * sizeof(double));
+    elements->qz = malloc(capacity * sizeof(double));
+
+    if (!elements->semi_major_axis || !elements->semi_minor_axis || !elements->eccentricity ||
+        !elements->mean_motion || !elements->perihelion_day || !elements->px || !elements->py ||
+        !elements->pz || !elements->qx || !elements->qy || !elements->qz) {
+        fprintf(stderr, "not enough memory for %zu bodies\n", capacity);
+        elements_free(elements);
+        return -1;
+    }
+    return 0;
+}
+
+void elements_init_with(elements_t* elements, double* storage, size_t capacity) {
+    elements->count = 0;
+    elements->capacity = capacity;
+    elements->owned = 0;
+    elements->semi_major_axis = storage;
+    elements->semi_minor_axis = storage + capacity;
+    elements->eccentricity = storage + 2 * capacity;
+    elements->mean_motion = storage + 3 * capacity;
+    elements->perihelion_day = storage + 4 * capacity;
+    elements->px = storage + 5 * capacity;
+    elements->py = storage + 6 * capacity;
+    elements->pz = storage + 7 * capacity;
+    elements->qx = storage + 8 * capacity;
+    elements->qy = storage + 9 * capacity;
+    elements->qz = storage + 10 * capacity;
+}
+
+int elements_reserve(elements_t* elements, size_t capacity) {
+    if (capacity <= elements->capacity) {
+        return 0;
+    }
+    if (!elements->owned) {
+        return -1;
+    }
+    double** arrays[ELEMENTS_FIELDS] = {
+        &elements->semi_major_axis, &elements->semi_minor_axis, &elements->eccentricity,
+        &elements->mean_motion, &elements->perihelion_day,
+        &elements->px, &elements->py, &elements->pz,
+        &elements->qx, &elements->qy, &elements->qz,
+    };
+    for (int f = 0; f < ELEMENTS_FIELDS; f++) {
+        double* grown = realloc(*arrays[f], capacity * sizeof(double));
+        if (grown == NULL) {
+            fprintf(stderr, "not enough memory for %zu bodies\n", capacity);
+            return -1;
+        }
+        *arrays[f] = grown;
+    }
+    elements->capacity = capacity;
+    return 0;
+}
+
+void elements_free(elements_t* elements) {
+    if (elements->owned) {
+        free(elements->semi_major_axis);
+        free(elements->semi_minor_axis);
+        free(elements->eccentricity);
+        free(elements->mean_motion);
+        free(elements->perihelion_day);
+        free(elements->px);
+        free(elements->py);
+        free(elements->pz);
+        free(elements->qx);
+        free(elements->qy);
+        free(elements->qz);
+    }
+    elements->semi_major_axis = NULL;
+    elements->semi_minor_axis = NULL;
+    elements->eccentricity = NULL;
+    elements->mean_motion = NULL;
+    elements->perihelion_day = NULL;
+    elements->px = elements->py = elements->pz = NULL;
+    elements->qx = elements->qy = elements->qz = NULL;
+    elements->count = 0;
+    elements->capacity = 0;
+}
+
+// Rotate the orbital plane axes by the argument of perihelion, the
+// inclination and the ascending node into the ecliptic frame
+void orbit_orientation(double inclination, double ascending_node, double argument_of_perihelion,
+                       double p[3], double q[3]) {
+    double cw = cos(argument_of_perihelion), sw = sin(argument_of_perihelion);
+    double cn = cos(ascending_node), sn = sin(ascending_node);
+    double ci = cos(inclination), si = sin(inclination);
+    p[0] = cw * cn - sw * sn * ci;
+    p[1] = cw * sn + sw * cn * ci;
+    p[2] = sw * si;
+    q[0] = -sw * cn - cw * sn * ci;
+    q[1] = -sw * sn + cw * cn * ci;
+    q[2] = cw * si;
+}
+
+void elements_arrays(const elements_t* elements, double* arrays[ELEMENTS_FIELDS]) {
+    double* all[ELEMENTS_FIELDS] = {
+        elements->semi_major_axis, elements->semi_minor_axis, elements->eccentricity,
+        elements->mean_motion, elements->perihelion_day,
+        elements->px, elements->py, elements->pz,
+        elements->qx, elements->qy, elements->qz,
+    };
+    memcpy(arrays, all, sizeof(all));
+}
+
+int elements_append(elements_t* elements, const elements_t* other) {
+    if (other->count > elements->capacity - elements->count) {
+        return -1;
+    }
+    double* to[ELEMENTS_FIELDS];
+    double* from[ELEMENTS_FIELDS];
+    elements_arrays(elements, to);
+    elements_arrays(other, from);
+    for (int f = 0; f < ELEMENTS_FIELDS; f++) {
+        memcpy(to[f] + elements->count, from[f], other->count * sizeof(double));
+    }
+    elements->count += other->count;
+    return 0;
+}
+
+// Append one body, everything derivable from the elements is computed here
+// once instead of on every date
+int elements_add(elements_t* elements, double semi_major_axis, double eccentricity,
+                 double period, double perihelion_day, double inclination,
+                 double ascending_node, double argument_of_perihelion) {
+    if (elements->count >= elements->capacity) {
+        return -1;
+    }
+    elements_set(elements, elements->count++, semi_major_axis, eccentricity, period, perihelion_day,
+                 inclination, ascending_node, argument_of_perihelion);
+    return 0;
+}
+
+void elements_set(elements_t* elements, size_t i, double semi_major_axis, double eccentricity,
+                  double period, double perihelion_day, double inclination,
+                  double ascending_node, double argument_of_perihelion) {
+    double p[3], q[3];
+    orbit_orientation(inclination, ascending_node, argument_of_perihelion, p, q);
+    elements->px[i] = p[0];
+    elements->py[i] = p[1];
+    elements->pz[i] = p[2];
+    elements->qx[i] = q[0];
+    elements->qy[i] = q[1];
+    elements->qz[i] = q[2];
+    elements->semi_major_axis[i] = semi_major_axis;
+    elements->semi_minor_axis[i] = semi_major_axis * sqrt(1 - eccentricity * eccentricity);
+    elements->eccentricity[i] = eccentricity;
+    elements->mean_motion[i] = 2 * PI / period;
+    elements->perihelion_day[i] = perihelion_day;
+}
+
+// Fill elements from the planets fetched in main()
+int elements_from_planets(elements_t* elements, planet_t* planets[], size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (elements_add(elements, planets[i]->semi_major_axis, planets[i]->eccentricity,
+                         planets[i]->period, date_to_julian(&planets[i]->perihelion_date),
+                         planets[i]->inclination * DEGREES, planets[i]->ascending_node * DEGREES,
+                         planets[i]->argument_of_perihelion * DEGREES) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Propagate every body to the given day number.
+// Same model as set_coordinates, but the position in the orbital plane is
+// taken straight from the eccentric anomaly: a(cos E - e), b sin E, which is
+// identical to r cos(v), r sin(v) without the atan2 and the extra sin/cos.
+// The orientation then costs two multiply-adds per axis.
+void propagate_all_day(const elements_t* elements, size_t n, double day, coordinates_t* out) {
+    const double* restrict a = elements->semi_major_axis;
+    const double* restrict b = elements->semi_minor_axis;
+    const double* restrict ecc = elements->eccentricity;
+    const double* restrict motion = elements->mean_motion;
+    const double* restrict perihelion = elements->perihelion_day;
+    const double* restrict px = elements->px;
+    const double* restrict py = elements->py;
+    const double* restrict pz = elements->pz;
+    const double* restrict qx = elements->qx;
+    const double* restrict qy = elements->qy;
+    const double* restrict qz = elements->qz;
+    double M[PROPAGATE_BLOCK], E[PROPAGATE_BLOCK], sinE[PROPAGATE_BLOCK], cosE[PROPAGATE_BLOCK];
+
+    for (size_t start = 0; start < n; start += PROPAGATE_BLOCK) {
+        size_t count = n - start < PROPAGATE_BLOCK ? n - start : PROPAGATE_BLOCK;
+
+        for (size_t j = 0; j < count; j++) {
+            M[j] = motion[start + j] * (day - perihelion[start + j]);
+        }
+        kepler_solve(M, ecc + start, E, sinE, cosE, count);
+
+        for (size_t j = 0; j < count; j++) {
+            size_t i = start + j;
+            double along = a[i] * (cosE[j] - ecc[i]);
+            double across = b[i] * sinE[j];
+            out[i].x = along * px[i] + across * qx[i];
+            out[i].y = along * py[i] + across * qy[i];
+            out[i].z = along * pz[i] + across * qz[i];
+        }
+    }
+}
+
+void propagate_all(const elements_t* elements, size_t n, const date_t* date, coordinates_t* out) {
+    propagate_all_day(elements, n, date_to_julian(date), out);
+}
+
+// Synthetic catalog spread over the asteroid belt and outer system, inclined
+// up to 20 degrees
+int elements_add_synthetic(elements_t* elements, size_t n) {
+    srand(1306);
+    for (size_t i = 0; i < n; i++) {
+        double a = 0.4 + 40.0 * rand() / RAND_MAX;
+        double e = 0.3 * rand() / RAND_MAX;
+        double period = 365.25 * a * sqrt(a); // Kepler's third law, in days
+        double perihelion = 2460000.0 + period * rand() / RAND_MAX;
+        double inclination = 20 * DEGREES * rand() / RAND_MAX;
+        double node = 2 * PI * rand() / RAND_MAX;
+        double argument = 2 * PI * rand() / RAND_MAX;
+        if (elements_add(elements, a, e, period, perihelion, inclination, node, argument) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int elements_synthetic(elements_t* elements, size_t n) {
+    if (elements_init(elements, n) != 0) {
+        return -1;
+    }
+    return elements_add_synthetic(elements, n);
+}
+
+// "bench [bodies] [dates]": propagate a synthetic catalog for a few dates
+int propagate_bench_command(int argc, char* argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    int dates = argc > 2 ? atoi(argv[2]) : 10;
+    if (n == 0 || dates <= 0) {
+        fprintf(stderr, "usage: planets bench [bodies] [dates]\n");
+        return 1;
+    }
+
+    elements_t elements;
+    if (elements_synthetic(&elements, n) != 0) {
+        return 1;
+    }
+    coordinates_t* out = malloc(n * sizeof(coordinates_t));
+    if (out == NULL) {
+        fprintf(stderr, "not enough memory for %zu positions\n", n);
+        elements_free(&elements);
+        return 1;
+    }
+
+    double start = bench_now();
+    for (int d = 0; d < dates; d++) {
+        propagate_all_day(&elements, n, 2460000.0 + d, out);
+    }
+    double elapsed = bench_now() - start;
+
+    bench_report("propagate_all", (double)n * dates, "bodies", elapsed);
+
+    free(out);
+    elements_free(&elements);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef PROPAGATE_H
+#define PROPAGATE_H
+
+#include <stddef.h>
+#include "planets.h"
+
+// Orbital elements for many bodies, one contiguous array per field so a
+// date can be propagated for the whole catalog in a single pass.
+// Inclination, ascending node and argument of perihelion are folded into the
+// unit vectors P (towards perihelion) and Q (90 degrees ahead in the orbital
+// plane) at load, so a heliocentric ecliptic position is just
+// a (cos E - e) P + b sin E Q.
+typedef struct Elements {
+    size_t count;
+    size_t capacity;
+    double *semi_major_axis; // AU
+    double *semi_minor_axis; // AU, a * sqrt(1 - e^2), precomputed at load
+    double *eccentricity;
+    double *mean_motion;     // radians per day, 2 * PI / period
+    double *perihelion_day;  // Julian Date of the last perihelion
+    double *px, *py, *pz;
+    double *qx, *qy, *qz;
+    int owned;               // 0 when the arrays live in caller storage
+} elements_t;
+
+// Number of per-body arrays, caller storage needs ELEMENTS_FIELDS * capacity doubles
+#define ELEMENTS_FIELDS 11
+
+// Degrees to radians for the angles kept in planet_t
+#define DEGREES (PI / 180)
+
+int elements_init(elements_t* elements, size_t capacity);
+
+// Same as elements_init but the arrays are carved out of storage, e.g. a
+// stack buffer for the handful of planets, and elements_free leaves it alone
+void elements_init_with(elements_t* elements, double* storage, size_t capacity);
+void elements_free(elements_t* elements);
+
+// Grow the arrays of elements from elements_init to hold capacity bodies
+int elements_reserve(elements_t* elements, size_t capacity);
+
+// Append every body of other, e.g. a mapped catalog after the planets; -1
+// when they don't fit
+int elements_append(elements_t* elements, const elements_t* other);
+
+// The per-body arrays in declaration order, for code that treats them alike
+void elements_arrays(const elements_t* elements, double* arrays[ELEMENTS_FIELDS]);
+
+// P and Q of an orbit, angles in radians
+void orbit_orientation(double inclination, double ascending_node, double argument_of_perihelion,
+                       double p[3], double q[3]);
+
+// Append one body, period in days, perihelion as a Julian Date, angles in radians
+int elements_add(elements_t* elements, double semi_major_axis, double eccentricity,
+                 double period, double perihelion_day, double inclination,
+                 double ascending_node, double argument_of_perihelion);
+
+// Overwrite body i < capacity in place, for loaders that fill slots out of
+// order; count is left alone
+void elements_set(elements_t* elements, size_t i, double semi_major_axis, double eccentricity,
+                  double period, double perihelion_day, double inclination,
+                  double ascending_node, double argument_of_perihelion);
+
+// Fill elements from the planets fetched in main()
+int elements_from_planets(elements_t* elements, planet_t* planets[], size_t n);
+
+// Reproducible random catalog of n bodies for the benchmarks
+int elements_synthetic(elements_t* elements, size_t n);
+
+// Append the same n synthetic bodies to elements, which must have room for them
+int elements_add_synthetic(elements_t* elements, size_t n);
+
+// Heliocentric ecliptic x/y/z of the first n bodies on the given date
+void propagate_all(const elements_t* elements, size_t n, const date_t* date, coordinates_t* out);
+
+// Same as propagate_all but for a Julian Date
+void propagate_all_day(const elements_t* elements, size_t n, double day, coordinates_t* out);
+
+// "bench" mode: propagate a synthetic catalog and report bodies/second
+int propagate_bench_command(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "series.h"
+#include "kepler.h"
+#include "bench.h"
+
+#define SERIES_ITERATIONS 2
+// More iterations than this and the body gets a full solve instead
+#define SERIES_MAX_ITERATIONS 6
+// Last Halley correction (radians) at which E counts as converged, the
+// next one would be around its cube
+#define SERIES_TOLERANCE 1e-6
+
+// Wrap an angle into [-PI, PI]
+static double wrap_angle(double angle) {
+    return angle - 2 * PI * nearbyint(angle / (2 * PI));
+}
+
+int series_init(series_t* series, const elements_t* elements, double start_day, double step) {
+    size_t n = elements->count;
+    series->elements = elements;
+    series->count = n;
+    series->day = start_day;
+    series->start_day = start_day;
+    series->step = step;
+    series->steps = 0;
+    series->fallbacks = 0;
+    series->incremental = 1;
+    series->mean_anomaly = malloc(n * sizeof(double));
+    series->increment = malloc(n * sizeof(double));
+    series->eccentric_anomaly = malloc(n * sizeof(double));
+    series->positions = malloc(n * sizeof(coordinates_t));
+
+    if (!series->mean_anomaly || !series->increment || !series->eccentric_anomaly || !series->positions) {
+        fprintf(stderr, "not enough memory for a series of %zu bodies\n", n);
+        series_free(series);
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        double motion = elements->mean_motion[i];
+        series->mean_anomaly[i] = wrap_angle(motion * (start_day - elements->perihelion_day[i]));
+        series->increment[i] = wrap_angle(motion * step);
+        if (fabs(series->increment[i]) > SERIES_MAX_INCREMENT) {
+            series->incremental = 0;
+        }
+    }
+
+    // The first step is always a full solve
+    kepler_solve(series->mean_anomaly, elements->eccentricity, series->eccentric_anomaly, NULL, NULL, n);
+    return 0;
+}
+
+void series_free(series_t* series) {
+    free(series->mean_anomaly);
+    free(series->increment);
+    free(series->eccentric_anomaly);
+    free(series->positions);
+    series->mean_anomaly = NULL;
+    series->increment = NULL;
+    series->eccentric_anomaly = NULL;
+    series->positions = NULL;
+}
+
+const coordinates_t* series_next(series_t* series) {
+    const elements_t* elements = series->elements;
+    double* restrict M = series->mean_anomaly;
+    double* restrict E = series->eccentric_anomaly;
+
+    for (size_t i = 0; i < series->count; i++) {
+        double e = elements->eccentricity[i];
+        double s = sin(E[i]);
+        double c = cos(E[i]);
+        double along = elements->semi_major_axis[i] * (c - e);
+        double across = elements->semi_minor_axis[i] * s;
+        series->positions[i].x = along * elements->px[i] + across * elements->qx[i];
+        series->positions[i].y = along * elements->py[i] + across * elements->qy[i];
+        series->positions[i].z = along * elements->pz[i] + across * elements->qz[i];
+
+        if (!series->incremental) {
+            continue;
+        }
+
+        // Advance M and predict E from dE/dM = 1 / (1 - e cos E)
+        double m = M[i] + series->increment[i];
+        double x = E[i] + series->increment[i] / (1 - e * c);
+        if (m > PI) {
+            m -= 2 * PI;
+            x -= 2 * PI;
+        } else if (m < -PI) {
+            m += 2 * PI;
+            x += 2 * PI;
+        }
+
+        // Halley from the prediction until the correction is negligible. Near
+        // perihelion of a very eccentric orbit 1 - e cos E is tiny and the
+        // prediction can be far off; give up and do a full solve then.
+        double delta;
+        int k = 0;
+        do {
+            s = sin(x);
+            c = cos(x);
+            double f = x - e * s - m;
+            double df = 1 - e * c;
+            delta = f * df / (df * df - 0.5 * f * e * s);
+            x -= delta;
+            k++;
+        } while ((k < SERIES_ITERATIONS || fabs(delta) > SERIES_TOLERANCE) && k < SERIES_MAX_ITERATIONS);
+        if (!(fabs(delta) <= SERIES_TOLERANCE)) {
+            kepler_solve(&m, &elements->eccentricity[i], &x, NULL, NULL, 1);
+            series->fallbacks++;
+        }
+        M[i] = m;
+        E[i] = x;
+    }
+
+    series->steps++;
+    series->day = series->start_day + series->steps * series->step;
+    if (!series->incremental) {
+        for (size_t i = 0; i < series->count; i++) {
+            M[i] = wrap_angle(M[i] + series->increment[i]);
+        }
+        kepler_solve(M, elements->eccentricity, E, NULL, NULL, series->count);
+    }
+    return series->positions;
+}
+
+// "series dd/mm/yyyy[Thh:mm] dd/mm/yyyy[Thh:mm] step_days": one CSV line per step with the
+// x/y/z of every planet, written as it is computed
+int series_command(int argc, char* argv[]) {
+    date_t start_date, end_date;
+    double step = argc > 3 ? atof(argv[3]) : 0;
+    if (argc < 4 || parse_date(argv[1], &start_date) != 0 || parse_date(argv[2], &end_date) != 0 || step <= 0) {
+        fprintf(stderr, "usage: planets series dd/mm/yyyy[Thh:mm] dd/mm/yyyy[Thh:mm] step_days\n");
+        return 1;
+    }
+
+    planet_t planet_data[NUM_PLANETS];
+    planet_t* planets[NUM_PLANETS];
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i] = &planet_data[i];
+    }
+    load_planets(planets);
+
+    elements_t elements;
+    if (elements_init(&elements, NUM_PLANETS) != 0 || elements_from_planets(&elements, planets, NUM_PLANETS) != 0) {
+        return 1;
+    }
+
+    double start_day = date_to_julian(&start_date);
+    double end_day = date_to_julian(&end_date);
+    series_t series;
+    if (series_init(&series, &elements, start_day, step) != 0) {
+        elements_free(&elements);
+        return 1;
+    }
+
+    printf("julian_date");
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        printf(",%s_x,%s_y,%s_z", planets[i]->name, planets[i]->name, planets[i]->name);
+    }
+    printf("\n");
+
+    double start = bench_now();
+    long steps = 0;
+    for (; series.day <= end_day; steps++) {
+        double day = series.day;
+        const coordinates_t* positions = series_next(&series);
+        printf("%.6f", day);
+        for (int i = 0; i < NUM_PLANETS; i++) {
+            printf(",%.6f,%.6f,%.6f", positions[i].x, positions[i].y, positions[i].z);
+        }
+        printf("\n");
+    }
+    double elapsed = bench_now() - start;
+
+    fprintf(stderr, "%ld steps (%s), %.3e body-steps/s\n", steps,
+            series.incremental ? "incremental" : "full solve per step",
+            elapsed > 0 ? steps * NUM_PLANETS / elapsed : 0);
+
+    series_free(&series);
+    elements_free(&elements);
+    return 0;
+}
+
+#define SERIES_BENCH_EPOCH 2460000.0
+#define SERIES_BENCH_BODIES 64
+
+// "series-bench [steps] [increment]": incremental series against
+// propagate_all_day for orbits of growing eccentricity, every body advancing
+// increment radians of mean anomaly per step
+int series_bench_command(int argc, char* argv[]) {
+    static const double eccentricities[] = {0.0, 0.5, 0.9, 0.95, 0.99};
+    long steps = argc > 1 ? atol(argv[1]) : 200;
+    double increment = argc > 2 ? atof(argv[2]) : 0.45;
+    if (steps <= 0 || increment <= 0 || increment > SERIES_MAX_INCREMENT) {
+        fprintf(stderr, "usage: planets series-bench [steps] [increment <= %.2f rad]\n", SERIES_MAX_INCREMENT);
+        return 1;
+    }
+
+    // 1 AU orbits, so the error is in AU and the step is the same for every body
+    double period = 365.25;
+    double step = increment * period / (2 * PI);
+    coordinates_t reference[SERIES_BENCH_BODIES];
+    printf("%d bodies, %ld steps of %.3f rad (%.2f days)\n\n", SERIES_BENCH_BODIES, steps, increment, step);
+
+    for (size_t k = 0; k < sizeof(eccentricities) / sizeof(eccentricities[0]); k++) {
+        elements_t elements;
+        if (elements_init(&elements, SERIES_BENCH_BODIES) != 0) {
+            return 1;
+        }
+        srand(1306);
+        for (int i = 0; i < SERIES_BENCH_BODIES; i++) {
+            // Spread the phases so some bodies pass perihelion on every run
+            double perihelion = SERIES_BENCH_EPOCH - period * i / SERIES_BENCH_BODIES;
+            elements_add(&elements, 1.0, eccentricities[k], period, perihelion, 20 * DEGREES * rand() / RAND_MAX,
+                         2 * PI * rand() / RAND_MAX, 2 * PI * rand() / RAND_MAX);
+        }
+
+        series_t series;
+        if (series_init(&series, &elements, SERIES_BENCH_EPOCH, step) != 0) {
+            elements_free(&elements);
+            return 1;
+        }
+        double worst = 0;
+        double elapsed = 0;
+        for (long n = 0; n < steps; n++) {
+            double day = series.day;
+            double start = bench_now();
+            const coordinates_t* positions = series_next(&series);
+            elapsed += bench_now() - start;
+            propagate_all_day(&elements, SERIES_BENCH_BODIES, day, reference);
+            for (int i = 0; i < SERIES_BENCH_BODIES; i++) {
+                double dx = positions[i].x - reference[i].x;
+                double dy = positions[i].y - reference[i].y;
+                double dz = positions[i].z - reference[i].z;
+                double error = sqrt(dx * dx + dy * dy + dz * dz);
+                worst = error > worst ? error : worst;
+            }
+        }
+        printf("e = %.2f  max error %.3e AU, %zu full solves, %.3e body-steps/s\n", eccentricities[k], worst,
+               series.fallbacks, elapsed > 0 ? steps * SERIES_BENCH_BODIES / elapsed : 0);
+
+        series_free(&series);
+        elements_free(&elements);
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <stddef.h>
+#include "planets.h"
+#include "propagate.h"
+
+// Largest mean anomaly advance per step (radians) for which the previous E
+// is a good enough seed. Bigger steps fall back to a full solve.
+#define SERIES_MAX_INCREMENT 0.5
+
+// Incremental propagation over evenly spaced days: the mean anomaly is
+// advanced by a precomputed increment and the previous eccentric anomaly
+// seeds the next solve, so each step usually costs two Halley iterations.
+// Bodies that don't converge from the seed get a full kepler_solve.
+typedef struct Series {
+    const elements_t* elements;
+    size_t count;
+    double day;            // Julian Date of the next step
+    double start_day;
+    double step;           // days between steps
+    long steps;            // steps taken, day is recomputed from it to avoid drift
+    int incremental;       // 0 when the step is too large to reuse E
+    size_t fallbacks;      // incremental steps that needed a full solve
+    double *mean_anomaly;  // kept in [-PI, PI]
+    double *increment;     // mean motion * step, also in [-PI, PI]
+    double *eccentric_anomaly;
+    coordinates_t *positions;
+} series_t;
+
+int series_init(series_t* series, const elements_t* elements, double start_day, double step);
+void series_free(series_t* series);
+
+// Positions at series->day, then advances one step
+const coordinates_t* series_next(series_t* series);
+
+// "series" mode: stream positions from start to end every step days
+int series_command(int argc, char* argv[]);
+
+// "series-bench" mode: series accuracy against propagate_all_day by eccentricity
+int series_bench_command(int argc, char* argv[]);
+
+#endif
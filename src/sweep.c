@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "sweep.h"
+#include "pool.h"
+#include "bench.h"
+#include "catalog.h"
+
+// One finished chunk inside a thread's output buffer
+typedef struct SweepRecord {
+    size_t begin;  // first date index
+    size_t end;
+    size_t offset; // first position in the owning buffer
+} sweep_record_t;
+
+// Output owned by a single thread, appended to without locking
+typedef struct SweepBuffer {
+    coordinates_t *positions;
+    size_t used;
+    size_t capacity;
+    sweep_record_t *records;
+    size_t record_count;
+    size_t record_capacity;
+    int failed;
+} sweep_buffer_t;
+
+typedef struct SweepJob {
+    const elements_t *elements;
+    double start_day;
+    double step;
+    int keep;
+    sweep_buffer_t *buffers;
+} sweep_job_t;
+
+static int sweep_reserve(sweep_buffer_t* buffer, size_t positions) {
+    if (buffer->used + positions > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        while (capacity < buffer->used + positions) {
+            capacity *= 2;
+        }
+        coordinates_t* grown = realloc(buffer->positions, capacity * sizeof(coordinates_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        buffer->positions = grown;
+        buffer->capacity = capacity;
+    }
+    if (buffer->record_count == buffer->record_capacity) {
+        size_t capacity = buffer->record_capacity ? buffer->record_capacity * 2 : 64;
+        sweep_record_t* grown = realloc(buffer->records, capacity * sizeof(sweep_record_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        buffer->records = grown;
+        buffer->record_capacity = capacity;
+    }
+    return 0;
+}
+
+// Pool task: one chunk of dates, each date a full propagate_all_day pass so
+// the vector Kepler kernel covers the whole catalog
+static void sweep_chunk(void* context, size_t begin, size_t end, int thread) {
+    sweep_job_t* job = context;
+    sweep_buffer_t* buffer = &job->buffers[thread];
+    size_t n = job->elements->count;
+
+    if (buffer->failed || sweep_reserve(buffer, job->keep ? (end - begin) * n : n) != 0) {
+        buffer->failed = 1;
+        return;
+    }
+
+    // Without an output the chunk reuses the same scratch positions
+    if (!job->keep) {
+        for (size_t d = begin; d < end; d++) {
+            propagate_all_day(job->elements, n, job->start_day + d * job->step, buffer->positions);
+        }
+        return;
+    }
+
+    buffer->records[buffer->record_count++] = (sweep_record_t){begin, end, buffer->used};
+    for (size_t d = begin; d < end; d++) {
+        propagate_all_day(job->elements, n, job->start_day + d * job->step, buffer->positions + buffer->used);
+        buffer->used += n;
+    }
+}
+
+typedef struct SweepSource {
+    const sweep_record_t *record;
+    const sweep_buffer_t *buffer;
+} sweep_source_t;
+
+static int compare_sources(const void* a, const void* b) {
+    size_t left = ((const sweep_source_t*)a)->record->begin;
+    size_t right = ((const sweep_source_t*)b)->record->begin;
+    return (left > right) - (left < right);
+}
+
+// Copy every thread's chunks into out in date order
+static int sweep_merge(sweep_buffer_t* buffers, int threads, size_t n, coordinates_t* out) {
+    size_t count = 0;
+    for (int t = 0; t < threads; t++) {
+        count += buffers[t].record_count;
+    }
+    sweep_source_t* sources = malloc(count * sizeof(sweep_source_t));
+    if (sources == NULL && count > 0) {
+        return -1;
+    }
+
+    size_t k = 0;
+    for (int t = 0; t < threads; t++) {
+        for (size_t r = 0; r < buffers[t].record_count; r++) {
+            sources[k++] = (sweep_source_t){&buffers[t].records[r], &buffers[t]};
+        }
+    }
+    qsort(sources, count, sizeof(sweep_source_t), compare_sources);
+
+    for (k = 0; k < count; k++) {
+        const sweep_record_t* record = sources[k].record;
+        memcpy(out + record->begin * n, sources[k].buffer->positions + record->offset,
+               (record->end - record->begin) * n * sizeof(coordinates_t));
+    }
+    free(sources);
+    return 0;
+}
+
+int sweep_run(const elements_t* elements, double start_day, double step, size_t dates,
+              int threads, coordinates_t* out, double* seconds) {
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+    sweep_buffer_t* buffers = calloc(threads, sizeof(sweep_buffer_t));
+    if (buffers == NULL) {
+        return -1;
+    }
+    sweep_job_t job = {elements, start_day, step, out != NULL, buffers};
+
+    double start = bench_now();
+    int result = pool_run(threads, dates, SWEEP_CHUNK_DATES, sweep_chunk, &job, NULL);
+    for (int t = 0; t < threads; t++) {
+        if (buffers[t].failed) {
+            result = -1;
+        }
+    }
+    if (result == 0 && out != NULL) {
+        result = sweep_merge(buffers, threads, elements->count, out);
+    }
+    if (seconds != NULL) {
+        *seconds = bench_now() - start;
+    }
+
+    for (int t = 0; t < threads; t++) {
+        free(buffers[t].positions);
+        free(buffers[t].records);
+    }
+    free(buffers);
+    return result;
+}
+
+// The bodies of a mapped catalog (propagated in place, elements_free leaves
+// them alone), else the eight planets when bodies is 0 (from load_planets:
+// the built-in table, or the API with PLANETS_SOURCE=api), otherwise a
+// synthetic catalog
+static int sweep_load(elements_t* elements, const catalog_t* catalog, size_t bodies) {
+    if (catalog->map != NULL) {
+        *elements = catalog->elements;
+        return 0;
+    }
+    if (bodies > 0) {
+        return elements_synthetic(elements, bodies);
+    }
+
+    planet_t planet_data[NUM_PLANETS];
+    planet_t* planets[NUM_PLANETS];
+    for (int i = 0; i < NUM_PLANETS; i++) {
+        planets[i] = &planet_data[i];
+    }
+    load_planets(planets);
+    if (elements_init(elements, NUM_PLANETS) != 0) {
+        return -1;
+    }
+    return elements_from_planets(elements, planets, NUM_PLANETS);
+}
+
+static int sweep_parse(int argc, char* argv[], const char* usage, double* start_day, double* step, size_t* dates) {
+    date_t start_date, end_date;
+    *step = argc > 3 ? atof(argv[3]) : 0;
+    if (argc < 4 || parse_date(argv[1], &start_date) != 0 || parse_date(argv[2], &end_date) != 0 || *step <= 0) {
+        fprintf(stderr, "usage: planets %s\n", usage);
+        return -1;
+    }
+    *start_day = date_to_julian(&start_date);
+    double end_day = date_to_julian(&end_date);
+    if (end_day < *start_day) {
+        fprintf(stderr, "usage: planets %s (the end date must not be before the start)\n", usage);
+        return -1;
+    }
+    *dates = (size_t)((end_day - *start_day) / *step) + 1;
+    return 0;
+}
+
+// "sweep dd/mm/yyyy dd/mm/yyyy step_days [threads] [bodies|catalog_file]
+// [output_file]": positions for every (date, body) pair, optionally written
+// to a binary file of x/y/z doubles in date order
+int sweep_command(int argc, char* argv[]) {
+    const char* usage = "sweep dd/mm/yyyy dd/mm/yyyy step_days [threads] [bodies|catalog_file] [output_file]";
+    double start_day, step, seconds;
+    size_t dates;
+    if (sweep_parse(argc, argv, usage, &start_day, &step, &dates) != 0) {
+        return 1;
+    }
+    int threads = argc > 4 ? atoi(argv[4]) : 0;
+    size_t bodies = 0;
+    catalog_t catalog;
+    if (catalog_argument(argc > 5 ? argv[5] : "0", &catalog, &bodies) != 0) {
+        return 1;
+    }
+    const char* path = argc > 6 ? argv[6] : NULL;
+    if (threads <= 0) {
+        threads = pool_default_threads();
+    }
+
+    elements_t elements;
+    if (sweep_load(&elements, &catalog, bodies) != 0) {
+        catalog_close(&catalog);
+        return 1;
+    }
+    size_t n = elements.count;
+
+    coordinates_t* out = NULL;
+    if (path != NULL) {
+        // The date range, step and catalog all come from the command line
+        if (n > 0 && dates > SIZE_MAX / sizeof(coordinates_t) / n) {
+            fprintf(stderr, "%zu dates x %zu bodies is too many positions to keep\n", dates, n);
+            elements_free(&elements);
+            catalog_close(&catalog);
+            return 1;
+        }
+        out = malloc(dates * n * sizeof(coordinates_t));
+        if (out == NULL) {
+            fprintf(stderr, "not enough memory for %zu positions\n", dates * n);
+            elements_free(&elements);
+            catalog_close(&catalog);
+            return 1;
+        }
+    }
+
+    int result = sweep_run(&elements, start_day, step, dates, threads, out, &seconds);
+    if (result == 0) {
+        printf("%zu dates x %zu bodies on %d threads\n", dates, n, threads);
+        bench_report("sweep", (double)dates * n, "positions", seconds);
+    }
+
+    if (result == 0 && path != NULL) {
+        FILE* file = fopen(path, "wb");
+        if (file == NULL || fwrite(out, sizeof(coordinates_t), dates * n, file) != dates * n) {
+            fprintf(stderr, "error writing %s\n", path);
+            result = -1;
+        }
+        if (file != NULL) {
+            fclose(file);
+        }
+    }
+
+    free(out);
+    elements_free(&elements);
+    catalog_close(&catalog);
+    return result == 0 ? 0 : 1;
+}
+
+// "sweep-scaling dd/mm/yyyy dd/mm/yyyy step_days [max_threads] [bodies|catalog_file]":
+// the same sweep on 1 to max_threads threads with speedup and efficiency
+int sweep_scaling_command(int argc, char* argv[]) {
+    const char* usage = "sweep-scaling dd/mm/yyyy dd/mm/yyyy step_days [max_threads] [bodies|catalog_file]";
+    double start_day, step;
+    size_t dates;
+    if (sweep_parse(argc, argv, usage, &start_day, &step, &dates) != 0) {
+        return 1;
+    }
+    int max_threads = argc > 4 ? atoi(argv[4]) : 0;
+    size_t bodies = 0;
+    catalog_t catalog;
+    if (catalog_argument(argc > 5 ? argv[5] : "10000", &catalog, &bodies) != 0) {
+        return 1;
+    }
+    if (max_threads <= 0) {
+        max_threads = pool_default_threads();
+    }
+
+    elements_t elements;
+    if (sweep_load(&elements, &catalog, bodies) != 0) {
+        catalog_close(&catalog);
+        return 1;
+    }
+
+    printf("%zu dates x %zu bodies\n\n%8s %10s %10s %10s\n", dates, elements.count,
+           "threads", "seconds", "speedup", "efficiency");
+    double baseline = 0;
+    for (int threads = 1; threads <= max_threads; threads++) {
+        double seconds;
+        if (sweep_run(&elements, start_day, step, dates, threads, NULL, &seconds) != 0) {
+            elements_free(&elements);
+            catalog_close(&catalog);
+            return 1;
+        }
+        if (threads == 1) {
+            baseline = seconds;
+        }
+        double speedup = seconds > 0 ? baseline / seconds : 0;
+        printf("%8d %10.4f %10.2f %9.0f%%\n", threads, seconds, speedup, 100 * speedup / threads);
+    }
+
+    elements_free(&elements);
+    catalog_close(&catalog);
+    return 0;
+}
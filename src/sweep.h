@@ -0,0 +1,20 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stddef.h>
+#include "propagate.h"
+
+// Dates per work-stealing chunk
+#define SWEEP_CHUNK_DATES 256
+
+// Propagate every body in elements on dates start_day + k * step for
+// k in [0, dates), in parallel. out (dates * elements->count positions, date
+// major) may be NULL when only the timing matters.
+int sweep_run(const elements_t* elements, double start_day, double step, size_t dates,
+              int threads, coordinates_t* out, double* seconds);
+
+// "sweep" and "sweep-scaling" modes
+int sweep_command(int argc, char* argv[]);
+int sweep_scaling_command(int argc, char* argv[]);
+
+#endif